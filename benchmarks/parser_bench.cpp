@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <httc/request_parser.hpp>
 #include <print>
 #include <string>
@@ -26,31 +27,44 @@ std::string generate_request(std::string_view size) {
     return base;
 }
 
+// Delivers the request in pieces of at most `segment_size` bytes, like a socket receiving it in
+// many TCP segments. A segment size of 0 delivers the whole request at once.
 class StringReader {
 public:
     asio::awaitable<std::expected<std::string_view, httc::ReaderError>> pull() {
-        if (read) {
+        if (pos >= str.size()) {
             co_return std::unexpected(httc::ReaderError::CLOSED);
-        } else {
-            read = true;
-            co_return str;
         }
+
+        auto n = segment_size == 0 ? str.size() - pos : std::min(segment_size, str.size() - pos);
+        auto piece = std::string_view(str).substr(pos, n);
+        pos += n;
+        co_return piece;
     };
 
     void set_data(std::string data) {
         str = data;
-        read = false;
+        pos = 0;
+    }
+
+    void set_segment_size(std::size_t size) {
+        segment_size = size;
     }
 
 private:
-    bool read = false;
+    std::size_t pos = 0;
+    std::size_t segment_size = 0;
     std::string str;
 };
 
-asio::awaitable<void> parser_benchmark(std::string_view size, int iterations) {
+asio::awaitable<void> parser_benchmark(std::string_view size, int iterations, std::size_t segment) {
     std::string request_data = generate_request(size);
     StringReader reader;
-    RequestParser parser(1024 * 1024, 16 * 1024 * 1024, reader);
+    reader.set_segment_size(segment);
+    // Room for the 1000 headers of "xl"
+    RequestParser parser(
+        1024 * 1024, 16 * 1024 * 1024, reader, ServerConfig{}.input_buffer_size, 2000
+    );
 
     size_t total_header_len = 0;
     for (int i = 0; i < iterations; ++i) {
@@ -70,7 +84,7 @@ asio::awaitable<void> parser_benchmark(std::string_view size, int iterations) {
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::println(stderr, "Usage: parser_bench <sm|lg|xl> [iterations]");
+        std::println(stderr, "Usage: parser_bench <sm|lg|xl> [iterations] [segment_size|mss]");
         return 1;
     }
 
@@ -80,8 +94,15 @@ int main(int argc, char** argv) {
         iterations = std::stoi(argv[2]);
     }
 
+    // Typical TCP maximum segment size on an Ethernet link
+    constexpr std::size_t MSS = 1460;
+    std::size_t segment = 0;
+    if (argc > 3) {
+        segment = std::string_view(argv[3]) == "mss" ? MSS : std::stoul(argv[3]);
+    }
+
     asio::io_context io_context;
-    asio::co_spawn(io_context, parser_benchmark(size, iterations), asio::detached);
+    asio::co_spawn(io_context, parser_benchmark(size, iterations, segment), asio::detached);
     io_context.run();
 
     return 0;
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <httc/request.hpp>
+#include <httc/router.hpp>
+#include <print>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace httc;
+
+// Route patterns like those of an API gateway: static, param, nested param and wildcard routes
+std::vector<std::string> generate_routes(int count) {
+    std::vector<std::string> routes;
+    for (int i = 0; i < count; ++i) {
+        switch (i % 4) {
+        case 0:
+            routes.push_back(std::format("/api/v{}/resource{}", i % 5, i));
+            break;
+        case 1:
+            routes.push_back(std::format("/api/v{}/resource{}/:id", i % 5, i));
+            break;
+        case 2:
+            routes.push_back(std::format("/api/v{}/resource{}/:id/items", i % 5, i));
+            break;
+        case 3:
+            routes.push_back(std::format("/static/bucket{}/*", i));
+            break;
+        }
+    }
+    return routes;
+}
+
+// A request path for each route, in a shuffled order
+std::vector<std::string> generate_paths(const std::vector<std::string>& routes) {
+    std::vector<std::string> paths;
+    for (auto route : routes) {
+        if (auto pos = route.find(":id"); pos != std::string::npos) {
+            route.replace(pos, 3, "12345");
+        }
+        if (route.ends_with("*")) {
+            route.replace(route.size() - 1, 1, "img/logo.png");
+        }
+        paths.push_back(route);
+    }
+
+    std::mt19937 rng(42);
+    std::shuffle(paths.begin(), paths.end(), rng);
+    return paths;
+}
+
+// The previous routing, for comparison: every route is matched against the path, and the best
+// category wins
+const URI* linear_find(const std::vector<URI>& routes, const URI& uri) {
+    const URI* matches[3] = {};
+    for (const auto& route : routes) {
+        auto match = route.match(uri);
+        if (match == URIMatch::FULL_MATCH) {
+            matches[0] = &route;
+        } else if (match == URIMatch::PARAM_MATCH) {
+            matches[1] = &route;
+        } else if (match == URIMatch::WILD_MATCH) {
+            matches[2] = &route;
+        }
+    }
+    for (auto m : matches) {
+        if (m != nullptr) {
+            return m;
+        }
+    }
+    return nullptr;
+}
+
+// Reports the fastest of a few rounds, which is the least disturbed by other processes
+template<typename F>
+void measure(std::string_view label, std::size_t routes, int lookups, F run) {
+    constexpr int ROUNDS = 5;
+
+    double best = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        run(lookups);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        auto ns = std::chrono::duration<double, std::nano>(elapsed).count() / lookups;
+        best = round == 0 ? ns : std::min(best, ns);
+    }
+
+    std::println("{:<6} {:>6} routes {:>12.1f} ns/lookup", label, routes, best);
+}
+
+int main(int argc, char** argv) {
+    int lookups = 100000;
+    if (argc > 1) {
+        lookups = std::stoi(argv[1]);
+    }
+
+    for (int count : { 10, 100, 1000, 10000 }) {
+        auto routes = generate_routes(count);
+        auto paths = generate_paths(routes);
+
+        Router router;
+        std::vector<URI> uris;
+        for (const auto& route : routes) {
+            // Streamed, so that streams_body() tells if a route was found
+            router.route(
+                route,
+                [](const Request&, Response&) -> asio::awaitable<void> {
+                    co_return;
+                },
+                { .stream_body = true }
+            );
+            uris.push_back(*URI::parse(route));
+        }
+
+        std::vector<Request> requests;
+        for (const auto& path : paths) {
+            Request req;
+            req.method = Method::GET;
+            req.uri = *URI::parse(path);
+            requests.push_back(std::move(req));
+        }
+
+        // streams_body() only looks up the route
+        measure("tree", routes.size(), lookups, [&](int n) {
+            std::size_t found = 0;
+            for (int i = 0; i < n; ++i) {
+                found += router.streams_body(requests[i % requests.size()]);
+            }
+            if (found != static_cast<std::size_t>(n)) {
+                std::println("tree lookup failed");
+            }
+        });
+
+        // The linear scan gets far fewer lookups, since each one matches every route
+        int linear_lookups = std::max(100, lookups / count);
+        measure("linear", routes.size(), linear_lookups, [&](int n) {
+            std::size_t found = 0;
+            for (int i = 0; i < n; ++i) {
+                found += linear_find(uris, requests[i % requests.size()].uri) != nullptr;
+            }
+            if (found != static_cast<std::size_t>(n)) {
+                std::println("linear lookup failed");
+            }
+        });
+    }
+
+    return 0;
+}
@@ -10,3 +10,6 @@ clear
 hyperfine --warmup 3 './zig-out/bin/parser_bench sm 1000000' './benchmarks/rust_compare/target/release/rust_compare sm 1000000'
 hyperfine --warmup 3 './zig-out/bin/parser_bench lg 200000' './benchmarks/rust_compare/target/release/rust_compare lg 200000'
 hyperfine --warmup 3 './zig-out/bin/parser_bench xl 10000' './benchmarks/rust_compare/target/release/rust_compare xl 10000'
+
+# Same request delivered in 1 byte, 7 byte and MSS sized pieces
+hyperfine --warmup 3 './zig-out/bin/parser_bench xl 100 1' './zig-out/bin/parser_bench xl 1000 7' './zig-out/bin/parser_bench xl 10000 mss'
@@ -59,7 +59,7 @@ asio::awaitable<void> login_handler(const Request& req, Response& res) {
         co_return;
     }
 
-    if (req.method == "GET") {
+    if (req.method == Method::GET) {
         res.headers.set("Content-Type", "text/html");
         res.set_body(
             "<html><body style='font-family: sans-serif; text-align: center; padding-top: 50px;'>"
@@ -70,7 +70,7 @@ asio::awaitable<void> login_handler(const Request& req, Response& res) {
             "<br><a href='/'>Back Home</a>"
             "</body></html>"
         );
-    } else if (req.method == "POST") {
+    } else if (req.method == Method::POST) {
         res.add_cookie("session_id=user_12345; HttpOnly; Path=/; Max-Age=3600");
 
         res.status = StatusCode::SEE_OTHER;
@@ -12,12 +12,10 @@ int main() {
         co_return;
     });
 
-    asio::io_context io_ctx;
     int port = 8080;
+    httc::Server server("0.0.0.0", port, router);
 
-    std::println("Listening on port {}", port);
-    httc::bind_and_listen("0.0.0.0", port, router, io_ctx);
-
-    io_ctx.run();
+    std::println("Listening on port {} with {} threads", port, server.threads());
+    server.run();
     return 0;
 }
@@ -12,14 +12,12 @@ int main() {
     router->route("/", httc::utils::FileHandler("index.html"));
     router->route("/public/*", httc::utils::DirectoryHandler("./public", true));
 
-    asio::io_context io_ctx;
     int port = 8080;
+    httc::Server server("0.0.0.0", port, router);
 
     std::println("Static server listening on port {}", port);
     std::println("Visit: http://localhost:{}", port);
 
-    httc::bind_and_listen("0.0.0.0", port, router, io_ctx);
-
-    io_ctx.run();
+    server.run();
     return 0;
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <asio/awaitable.hpp>
+#include <expected>
+#include <string_view>
+
+namespace httc {
+
+enum class RequestParserError {
+    READER_CLOSED,
+    INVALID_REQUEST_LINE,
+    INVALID_HEADER,
+    UNSUPPORTED_TRANSFER_ENCODING,
+    CONTENT_TOO_LARGE,
+    HEADER_TOO_LARGE,
+    TOO_MANY_HEADERS,
+    INVALID_CHUNK_ENCODING,
+};
+
+// Reads a request body as it arrives, for routes registered with RouteOptions::stream_body.
+// Content-Length and chunked bodies are both returned as plain data, and nothing more is read
+// from the connection until the next piece is asked for.
+class BodyReader {
+    using ReadFn = asio::awaitable<std::expected<std::string_view, RequestParserError>> (*)(void*);
+
+public:
+    template<typename P>
+    BodyReader(P& parser)
+    : m_parser(&parser), m_read_fn([](void* p) {
+          return static_cast<P*>(p)->read_body_piece();
+      }) {
+    }
+
+    // Returns the next piece of the body, or an empty view once the whole body has been read.
+    // Trailers of a chunked body are available in Request::trailers after that.
+    // The piece is only valid until the next call.
+    asio::awaitable<std::expected<std::string_view, RequestParserError>> read() {
+        return m_read_fn(m_parser);
+    }
+
+private:
+    void* m_parser;
+    ReadFn m_read_fn;
+};
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace httc {
+
+// Well-known header names, which Headers can look up without searching its entries
+enum class Header : std::uint8_t {
+    ACCEPT,
+    ACCEPT_CHARSET,
+    ACCEPT_ENCODING,
+    ACCEPT_LANGUAGE,
+    ACCEPT_RANGES,
+    ACCESS_CONTROL_ALLOW_CREDENTIALS,
+    ACCESS_CONTROL_ALLOW_HEADERS,
+    ACCESS_CONTROL_ALLOW_METHODS,
+    ACCESS_CONTROL_ALLOW_ORIGIN,
+    ACCESS_CONTROL_EXPOSE_HEADERS,
+    ACCESS_CONTROL_MAX_AGE,
+    ACCESS_CONTROL_REQUEST_HEADERS,
+    ACCESS_CONTROL_REQUEST_METHOD,
+    AGE,
+    ALLOW,
+    AUTHORIZATION,
+    CACHE_CONTROL,
+    CONNECTION,
+    CONTENT_DISPOSITION,
+    CONTENT_ENCODING,
+    CONTENT_LANGUAGE,
+    CONTENT_LENGTH,
+    CONTENT_LOCATION,
+    CONTENT_RANGE,
+    CONTENT_SECURITY_POLICY,
+    CONTENT_TYPE,
+    COOKIE,
+    DATE,
+    ETAG,
+    EXPECT,
+    EXPIRES,
+    FORWARDED,
+    FROM,
+    HOST,
+    IF_MATCH,
+    IF_MODIFIED_SINCE,
+    IF_NONE_MATCH,
+    IF_RANGE,
+    IF_UNMODIFIED_SINCE,
+    KEEP_ALIVE,
+    LAST_MODIFIED,
+    LINK,
+    LOCATION,
+    MAX_FORWARDS,
+    ORIGIN,
+    PRAGMA,
+    PROXY_AUTHENTICATE,
+    PROXY_AUTHORIZATION,
+    RANGE,
+    REFERER,
+    RETRY_AFTER,
+    SERVER,
+    SET_COOKIE,
+    STRICT_TRANSPORT_SECURITY,
+    TE,
+    TRAILER,
+    TRANSFER_ENCODING,
+    UPGRADE,
+    USER_AGENT,
+    VARY,
+    VIA,
+    WWW_AUTHENTICATE,
+    X_FORWARDED_FOR,
+    X_FORWARDED_HOST,
+    X_FORWARDED_PROTO,
+    X_REQUESTED_WITH,
+};
+
+constexpr std::size_t HEADER_COUNT = static_cast<std::size_t>(Header::X_REQUESTED_WITH) + 1;
+
+// Returns the canonical name of a header, like "Content-Length"
+std::string_view header_name(Header header);
+
+// Case insensitive hash of a header name, keyed with a random key drawn at process startup, so
+// clients can't pick names that collide in Headers. Names that only differ in ASCII case hash
+// the same, and a few other names do too, so equal hashes must be confirmed with
+// header_names_equal
+std::uint32_t hash_header_name(std::string_view name);
+
+// Compares two header names, ignoring ASCII case
+bool header_names_equal(std::string_view a, std::string_view b);
+
+// Returns the well-known header with this name, ignoring case, or std::nullopt.
+// Costs one compile-time perfect hash of the length and the first and last 8 bytes of the name,
+// and one comparison
+std::optional<Header> find_header(std::string_view name);
+
+}
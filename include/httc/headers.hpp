@@ -1,15 +1,23 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <format>
+#include <iterator>
 #include <memory>
 #include <memory_resource>
 #include <optional>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "httc/header_names.hpp"
+#include "httc/small_vector.hpp"
 
 namespace httc {
 
+// Entries are stored in insertion order in a flat array, and names are found by a linear search
+// over their precomputed hashes. Above INDEX_THRESHOLD entries, a hash index is kept as well.
 class Headers {
 public:
     Headers();
@@ -37,107 +45,134 @@ public:
     // WARNING: The header and value must be valid for the lifetime of this Headers object.
     void add_view(std::string_view header, std::string_view value);
 
+    // Same as set_view, without validating the header and value again.
+    // WARNING: The header must be a valid token and the value a valid header value.
+    void set_view_unchecked(std::string_view header, std::string_view value);
+
     // Returns the number of values stored
     [[nodiscard]] std::size_t size() const;
 
     // Get the first value for the given header, or std::nullopt if not found.
     [[nodiscard]] std::optional<std::string_view> get_one(std::string_view header) const;
 
-    [[nodiscard]] auto get(std::string_view header) const {
-        return m_map.equal_range(header);
-    }
-
-private:
-    // FNV-1a hash for case insensitive strings
-    struct CaseInsensitiveHash {
-        using is_transparent = void;
+    // Get the first value for a well-known header, or std::nullopt if not found.
+    // This is a direct lookup, without hashing the name.
+    [[nodiscard]] std::optional<std::string_view> get_one(Header header) const;
 
-        size_t operator()(std::string_view str) const {
-            return hash(str);
+public:
+    // Types for STL container compatibility
+    using value_type = std::pair<std::string_view, std::string_view>;
+    using reference = const value_type&;
+    using const_reference = const value_type&;
+    using iterator = const value_type*;
+    using const_iterator = const value_type*;
+
+    // Iterates over the entries with one header name, in insertion order
+    class ValueIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Headers::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        ValueIterator() = default;
+
+        reference operator*() const {
+            return m_headers->m_entries[m_index];
         }
-
-    private:
-        template<typename S>
-        size_t hash(const S& str) const {
-            const size_t fnv_prime = 10990515241UL;
-            size_t hash = 14695981039346656037UL;
-            for (char c : str) {
-                hash ^= static_cast<unsigned char>(tolower(c));
-                hash *= fnv_prime;
-            }
-            return hash;
+        pointer operator->() const {
+            return &m_headers->m_entries[m_index];
         }
-    };
 
-    struct CaseInsensitiveSearch {
-        using is_transparent = void;
-
-        bool operator()(const std::string& a, const std::string& b) const {
-            return compare(a, b);
-        }
-        bool operator()(const std::string& a, std::string_view b) const {
-            return compare(a, b);
+        ValueIterator& operator++() {
+            m_index = m_headers->find(m_name, m_hash, m_index + 1);
+            return *this;
         }
-        bool operator()(std::string_view a, const std::string& b) const {
-            return compare(a, b);
+        ValueIterator operator++(int) {
+            auto it = *this;
+            ++*this;
+            return it;
         }
-        bool operator()(std::string_view a, std::string_view b) const {
-            return compare(a, b);
+
+        bool operator==(const ValueIterator& other) const {
+            return m_index == other.m_index;
         }
 
     private:
-        template<typename S1, typename S2>
-        bool compare(const S1& a, const S2& b) const {
-            if (a.size() != b.size()) {
-                return false;
-            }
-            for (size_t i = 0; i < a.size(); i++) {
-                if (tolower(a[i]) != tolower(b[i])) {
-                    return false;
-                }
-            }
-            return true;
+        ValueIterator(
+            const Headers* headers, std::string_view name, std::uint32_t hash, std::size_t index
+        )
+        : m_headers(headers), m_name(name), m_hash(hash), m_index(index) {
         }
+
+        const Headers* m_headers = nullptr;
+        std::string_view m_name;
+        std::uint32_t m_hash = 0;
+        std::size_t m_index = 0;
+
+        friend class Headers;
     };
 
-public:
-    // Types for STL container compatibility
-    using value_type = std::pair<const std::string_view, std::string_view>;
-    using reference = value_type&;
-    using const_reference = const value_type&;
-    using iterator = std::unordered_multimap<
-        std::string_view, std::string_view, CaseInsensitiveHash, CaseInsensitiveSearch>::iterator;
-    using const_iterator = std::unordered_multimap<
-        std::string_view, std::string_view, CaseInsensitiveHash,
-        CaseInsensitiveSearch>::const_iterator;
-
-    // Iterator interface
-    iterator begin() {
-        return m_map.begin();
-    }
-    iterator end() {
-        return m_map.end();
-    }
+    // Returns the entries with the given header name, in insertion order
+    [[nodiscard]] std::pair<ValueIterator, ValueIterator> get(std::string_view header) const;
+
+    // Iterator interface, in insertion order
     const_iterator begin() const {
-        return m_map.begin();
+        return m_entries.begin();
     }
     const_iterator end() const {
-        return m_map.end();
+        return m_entries.end();
     }
     const_iterator cbegin() const {
-        return m_map.cbegin();
+        return m_entries.begin();
     }
     const_iterator cend() const {
-        return m_map.cend();
+        return m_entries.end();
     }
 
 private:
+    static constexpr std::size_t INLINE_ENTRIES = 16;
+    static constexpr std::size_t INDEX_THRESHOLD = 32;
+
+    // Returns the index of the first entry at or after `from` with this name, or size()
+    std::size_t find(std::string_view name, std::uint32_t hash, std::size_t from = 0) const;
+
+    // Returns the index of the first entry with this name using m_index, or size()
+    std::size_t indexed_find(std::string_view name, std::uint32_t hash) const;
+
+    // First slot of m_index to probe for this hash
+    std::size_t index_slot(std::uint32_t hash) const;
+
+    // Records the first entry of a name in m_index
+    void index_insert(std::uint32_t hash, std::uint32_t index);
+
+    // Returns the index of the first entry with this name, or size()
+    std::size_t first_of(std::string_view name, std::uint32_t hash) const;
+
     std::string_view allocate_string(std::string_view sv);
 
+    // Appends an entry, and records it in the well-known header slots and in the index.
+    // `hash` is the hash_header_name of the header
+    void emplace(std::string_view header, std::string_view value, std::uint32_t hash);
+
+    // Deletes every entry with this name. Returns true if any entry was deleted
+    bool erase(std::string_view header, std::uint32_t hash);
+
+    // Rebuilds the well-known header slots and the index after entries were removed
+    void rebuild_lookups();
+
 private:
-    std::unordered_multimap<
-        std::string_view, std::string_view, CaseInsensitiveHash, CaseInsensitiveSearch>
-        m_map;
+    SmallVector<value_type, INLINE_ENTRIES> m_entries;
+    // Name hash of each entry, kept apart so several can be compared at once
+    SmallVector<std::uint32_t, INLINE_ENTRIES> m_hashes;
+
+    // Open addressing table of index + 1 of the first entry of each name, or 0, probed linearly.
+    // Only used above INDEX_THRESHOLD entries
+    std::vector<std::uint32_t> m_index;
+
+    // Index + 1 of the first entry of each well-known header, or 0
+    std::array<std::uint32_t, HEADER_COUNT> m_known{};
 
     std::unique_ptr<std::pmr::monotonic_buffer_resource> m_pool;
     friend struct std::formatter<Headers>;
@@ -149,7 +184,7 @@ template<>
 struct std::formatter<httc::Headers> : std::formatter<std::string> {
     auto format(const httc::Headers& headers, std::format_context& ctx) const {
         auto out = ctx.out();
-        for (const auto& [key, value] : headers.m_map) {
+        for (const auto& [key, value] : headers.m_entries) {
             out = std::format_to(out, "{}: {}\n", key, value);
         }
         return out;
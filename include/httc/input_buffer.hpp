@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace httc {
+
+// Per-thread free lists of buffer storage, by size. Connections take storage when data arrives
+// and give it back once it has been consumed, so idle connections hold none
+class BufferPool {
+public:
+    // Free blocks kept per size and thread. Blocks released beyond that are freed
+    static constexpr std::size_t MAX_FREE_BLOCKS = 64;
+
+    [[nodiscard]] static std::unique_ptr<char[]> acquire(std::size_t size);
+    static void release(std::unique_ptr<char[]> block, std::size_t size);
+};
+
+// Fixed capacity buffer for bytes received on a connection.
+// Consuming bytes only moves the read offset, and the buffer rewinds for free once everything
+// has been consumed. Unread bytes are moved to the front only when the free space after them
+// is smaller than the consumed space before them.
+// The storage comes from the BufferPool on first use, never grows, and can be given back while
+// the buffer is empty.
+class InputBuffer {
+public:
+    explicit InputBuffer(std::size_t capacity);
+    ~InputBuffer();
+
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    // Unread bytes. Invalidated by append
+    [[nodiscard]] std::string_view data() const;
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] std::size_t capacity() const;
+
+    // Copies as much of `bytes` as fits and returns the number of bytes copied.
+    // Returns 0 only if the buffer is full of unread bytes (or `bytes` is empty).
+    std::size_t append(std::string_view bytes);
+
+    // Returns the free space after the unread bytes, making room first if worthwhile.
+    // Bytes written there become unread once committed. Empty if the buffer is full
+    [[nodiscard]] std::span<char> prepare();
+    void commit(std::size_t n);
+
+    // Marks the first n unread bytes as consumed
+    void consume(std::size_t n);
+
+    // Drops every unread byte
+    void clear();
+
+    // Gives the storage back to the pool if there are no unread bytes. The next prepare or append
+    // takes storage again
+    void release();
+    [[nodiscard]] bool holds_storage() const;
+
+private:
+    void make_room();
+
+private:
+    std::unique_ptr<char[]> m_storage;
+    std::size_t m_capacity;
+    std::size_t m_begin = 0;
+    std::size_t m_end = 0;
+};
+
+}
@@ -3,7 +3,20 @@
 #include <asio/awaitable.hpp>
 #include <asio/buffer.hpp>
 #include <asio/ip/tcp.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 #include <vector>
 #include "httc/server_config.hpp"
@@ -21,29 +34,272 @@ concept Reader = requires(T t) {
     { t.pull() } -> std::same_as<asio::awaitable<std::expected<std::string_view, ReaderError>>>;
 };
 
+// A reader that can also read straight into storage owned by the caller.
+// pull_into returns the number of bytes written to the front of `buffer`
 template<typename T>
-concept Writer = requires(T t, std::vector<asio::const_buffer> b) {
+concept DirectReader = Reader<T> && requires(T t, std::span<char> buffer) {
+    { t.pull_into(buffer) } -> std::same_as<asio::awaitable<std::expected<std::size_t, ReaderError>>>;
+};
+
+// A DirectReader that can wait for data to arrive before being given storage to read it into, so
+// callers only hold storage while there is data
+template<typename T>
+concept WaitingReader = DirectReader<T> && requires(T t) {
+    { t.wait() } -> std::same_as<asio::awaitable<std::expected<void, ReaderError>>>;
+};
+
+// The buffers of one vectored write, held inline so that gathering them does not allocate. It is
+// an asio ConstBufferSequence. Responses use at most MAX_BUFFERS - 1 buffers, which leaves a writer
+// room to put its own data in front
+class WriteBuffers {
+public:
+    static constexpr std::size_t MAX_BUFFERS = 4;
+
+    using value_type = asio::const_buffer;
+    using const_iterator = const asio::const_buffer*;
+
+    WriteBuffers() = default;
+    WriteBuffers(std::initializer_list<asio::const_buffer> buffers) {
+        for (const auto& buffer : buffers) {
+            push_back(buffer);
+        }
+    }
+
+    void push_back(asio::const_buffer buffer) {
+        check_capacity();
+        m_buffers[m_size++] = buffer;
+    }
+
+    void push_front(asio::const_buffer buffer) {
+        check_capacity();
+        for (std::size_t i = m_size; i > 0; i--) {
+            m_buffers[i] = m_buffers[i - 1];
+        }
+        m_buffers[0] = buffer;
+        m_size++;
+    }
+
+    const_iterator begin() const {
+        return m_buffers.data();
+    }
+    const_iterator end() const {
+        return m_buffers.data() + m_size;
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+private:
+    void check_capacity() const {
+        if (m_size == MAX_BUFFERS) {
+            throw std::length_error("Too many buffers in one write");
+        }
+    }
+
+    std::array<asio::const_buffer, MAX_BUFFERS> m_buffers;
+    std::size_t m_size = 0;
+};
+
+template<typename T>
+concept Writer = requires(T t, WriteBuffers b) {
     { t.write(b) } -> std::same_as<asio::awaitable<void>>;
 };
 
+// A writer that may hold written data back until flush()
+template<typename T>
+concept FlushableWriter = Writer<T> && requires(T t) {
+    { t.flush() } -> std::same_as<asio::awaitable<void>>;
+};
+
+// A writer that can send part of a file by itself, without the data going through user space.
+// send_file writes `size` bytes of the file descriptor `fd` from `offset`
+template<typename T>
+concept FileWriter = Writer<T> && requires(T t, int fd, std::uint64_t offset, std::size_t size) {
+    { t.send_file(fd, offset, size) } -> std::same_as<asio::awaitable<void>>;
+};
+
 class SocketReader {
 public:
     SocketReader(asio::ip::tcp::socket& socket, const ServerConfig& cfg);
     asio::awaitable<std::expected<std::string_view, ReaderError>> pull();
+    asio::awaitable<std::expected<std::size_t, ReaderError>> pull_into(std::span<char> buffer);
+    // Waits until the socket has data or is closed
+    asio::awaitable<std::expected<void, ReaderError>> wait();
 
 private:
-    std::array<char, 8192> m_buffer;
+    static constexpr std::size_t BUFFER_SIZE = 8192;
+
+    // Maps the error of a socket operation, which must have failed
+    static ReaderError reader_error(const asio::error_code& ec);
+
+    // Only used by pull(), allocated on first use
+    std::unique_ptr<char[]> m_buffer;
     asio::ip::tcp::socket& m_sock;
+    // Set by wait(), so the next pull_into first tries to read without waiting again
+    bool m_readable = false;
     const ServerConfig& m_cfg;
 };
 
 class SocketWriter {
 public:
     SocketWriter(asio::ip::tcp::socket& socket);
-    asio::awaitable<void> write(std::vector<asio::const_buffer> buffers);
+    asio::awaitable<void> write(WriteBuffers buffers);
+#if defined(__linux__)
+    // Uses sendfile(2), waiting for the socket to be writable when its send buffer is full
+    asio::awaitable<void> send_file(int fd, std::uint64_t offset, std::size_t size);
+#endif
 
 private:
     asio::ip::tcp::socket& m_sock;
 };
 
+// Holds written data back until flush(), so the responses to pipelined requests that arrived
+// together, and the small writes of a streamed response, go out in a single write. Data is
+// copied, except past `max_pending` bytes, where the held back data and the new buffers are
+// written at once in one vectored write. flush_when_idle() also writes the held back data when
+// nothing else runs
+template<Writer W>
+class BatchingWriter {
+public:
+    static constexpr std::size_t DEFAULT_MAX_PENDING = 64 * 1024;
+
+    explicit BatchingWriter(W& writer, std::size_t max_pending = DEFAULT_MAX_PENDING)
+    : m_writer(writer), m_max_pending(max_pending) {
+    }
+
+    asio::awaitable<void> write(WriteBuffers buffers) {
+        // flush_when_idle() may be writing the held back data
+        while (m_writing) {
+            co_await wait();
+        }
+
+        if (m_pending.size() + asio::buffer_size(buffers) > m_max_pending) {
+            if (!m_pending.empty()) {
+                buffers.push_front(asio::buffer(m_pending));
+            }
+            co_await write_pending(buffers);
+            co_return;
+        }
+
+        for (const auto& buffer : buffers) {
+            m_pending.append(static_cast<const char*>(buffer.data()), buffer.size());
+        }
+        notify();
+    }
+
+    asio::awaitable<void> flush() {
+        while (m_writing) {
+            co_await wait();
+        }
+        if (m_pending.empty()) {
+            co_return;
+        }
+        co_await write_pending({ asio::buffer(m_pending) });
+    }
+
+    // Flushes whenever data is held back and the executor got to run something else, which means
+    // the writer of that data waits, on the client or on anything else. Writes of one handler that
+    // do not wait in between still go out together. Runs until cancelled
+    asio::awaitable<void> flush_when_idle() {
+        while (true) {
+            while (m_pending.empty() || m_writing) {
+                co_await wait();
+            }
+            co_await flush();
+        }
+    }
+
+    // Writes the held back data first, since the file is sent by `writer` directly
+    asio::awaitable<void> send_file(int fd, std::uint64_t offset, std::size_t size)
+        requires FileWriter<W>
+    {
+        co_await flush();
+        co_await m_writer.send_file(fd, offset, size);
+    }
+
+    // Size of the data held back
+    std::size_t pending() const {
+        return m_pending.size();
+    }
+
+private:
+    // Writes `buffers`, which start with the held back data, while the other writes wait
+    asio::awaitable<void> write_pending(WriteBuffers buffers) {
+        struct WritingGuard {
+            BatchingWriter& writer;
+            ~WritingGuard() {
+                writer.m_writing = false;
+                writer.notify();
+            }
+        };
+
+        m_writing = true;
+        WritingGuard guard{ *this };
+        co_await m_writer.write(buffers);
+        m_pending.clear();
+    }
+
+    // Waits until notify() is called
+    asio::awaitable<void> wait() {
+        if (!m_changed.has_value()) {
+            m_changed.emplace(
+                co_await asio::this_coro::executor, asio::steady_timer::time_point::max()
+            );
+        }
+        // Cancellation by notify() is the expected way to wake up
+        asio::error_code ec;
+        co_await m_changed->async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+
+    // Wakes up flush_when_idle() when data is held back, and the writes waiting for a write
+    void notify() {
+        if (m_changed.has_value()) {
+            m_changed->cancel();
+        }
+    }
+
+    W& m_writer;
+    std::size_t m_max_pending;
+    // Keeps its capacity, so a connection reuses the same storage for all its output
+    std::string m_pending;
+    // A write of the held back data is in progress
+    bool m_writing = false;
+    // Never expires, created by the first wait
+    std::optional<asio::steady_timer> m_changed;
+};
+
+// Flushes `writer` before every read, so held back responses are sent before waiting for the
+// client. Requests that were already received are parsed without reading, and their responses
+// stay held back until then
+template<Reader R, FlushableWriter W>
+class FlushingReader {
+public:
+    FlushingReader(R& reader, W& writer) : m_reader(reader), m_writer(writer) {
+    }
+
+    asio::awaitable<std::expected<std::string_view, ReaderError>> pull() {
+        co_await m_writer.flush();
+        co_return co_await m_reader.pull();
+    }
+
+    asio::awaitable<std::expected<std::size_t, ReaderError>> pull_into(std::span<char> buffer)
+        requires DirectReader<R>
+    {
+        co_await m_writer.flush();
+        co_return co_await m_reader.pull_into(buffer);
+    }
+
+    asio::awaitable<std::expected<void, ReaderError>> wait()
+        requires WaitingReader<R>
+    {
+        co_await m_writer.flush();
+        co_return co_await m_reader.wait();
+    }
+
+private:
+    R& m_reader;
+    W& m_writer;
+};
+
 }
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace httc {
+
+// A request method. The standard methods are stored as their id, and any other token is kept as
+// OTHER along with its text.
+class Method {
+public:
+    enum Id : std::uint8_t {
+        GET,
+        HEAD,
+        POST,
+        PUT,
+        DELETE,
+        CONNECT,
+        OPTIONS,
+        TRACE,
+        PATCH,
+        OTHER,
+    };
+
+    // Number of standard methods, which are the ids before OTHER
+    static constexpr std::size_t COUNT = OTHER;
+
+    // Returns the id of a standard method, or std::nullopt for any other token.
+    // Methods are case-sensitive
+    [[nodiscard]] static constexpr std::optional<Id> find(std::string_view token);
+
+    // Name of a standard method
+    [[nodiscard]] static constexpr std::string_view name(Id id) {
+        return NAMES[id];
+    }
+
+    constexpr Method() = default;
+    constexpr Method(Id id) : m_id(id) {
+    }
+    Method(std::string_view token) {
+        auto id = find(token);
+        if (id.has_value()) {
+            m_id = *id;
+        } else {
+            m_id = OTHER;
+            m_token = token;
+        }
+    }
+    Method(const char* token) : Method(std::string_view(token)) {
+    }
+
+    [[nodiscard]] constexpr Id id() const {
+        return m_id;
+    }
+
+    [[nodiscard]] std::string_view name() const {
+        return m_id == OTHER ? std::string_view(m_token) : NAMES[m_id];
+    }
+
+    bool operator==(const Method& other) const {
+        return m_id == other.m_id && (m_id != OTHER || m_token == other.m_token);
+    }
+
+private:
+    static constexpr std::string_view NAMES[COUNT] = {
+        "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH",
+    };
+
+    // Packs up to 8 bytes into an integer, first byte lowest, zero padded
+    static constexpr std::uint64_t load(std::string_view str) {
+        std::uint64_t word = 0;
+        if consteval {
+            for (std::size_t i = 0; i < str.size(); i++) {
+                word |= std::uint64_t(static_cast<unsigned char>(str[i])) << (8 * i);
+            }
+        } else {
+            std::memcpy(&word, str.data(), str.size());
+            if constexpr (std::endian::native == std::endian::big) {
+                word = std::byteswap(word);
+            }
+        }
+        return word;
+    }
+
+    Id m_id = GET;
+    // Only set for OTHER
+    std::string m_token;
+};
+
+constexpr std::optional<Method::Id> Method::find(std::string_view token) {
+    if (token.empty() || token.size() > sizeof(std::uint64_t)) {
+        return std::nullopt;
+    }
+
+    // Compare the whole token at once. The length check rejects tokens padded with zeros
+    Id id;
+    switch (load(token)) {
+    case load("GET"):
+        id = GET;
+        break;
+    case load("HEAD"):
+        id = HEAD;
+        break;
+    case load("POST"):
+        id = POST;
+        break;
+    case load("PUT"):
+        id = PUT;
+        break;
+    case load("DELETE"):
+        id = DELETE;
+        break;
+    case load("CONNECT"):
+        id = CONNECT;
+        break;
+    case load("OPTIONS"):
+        id = OPTIONS;
+        break;
+    case load("TRACE"):
+        id = TRACE;
+        break;
+    case load("PATCH"):
+        id = PATCH;
+        break;
+    default:
+        return std::nullopt;
+    }
+    if (token.size() != NAMES[id].size()) {
+        return std::nullopt;
+    }
+    return id;
+}
+
+// A set of standard methods, as one bit per method
+class MethodSet {
+public:
+    constexpr MethodSet() = default;
+    constexpr MethodSet(std::initializer_list<Method::Id> ids) {
+        for (auto id : ids) {
+            insert(id);
+        }
+    }
+
+    constexpr void insert(Method::Id id) {
+        m_mask |= bit(id);
+    }
+
+    [[nodiscard]] constexpr bool contains(Method::Id id) const {
+        return (m_mask & bit(id)) != 0;
+    }
+
+    [[nodiscard]] constexpr bool empty() const {
+        return m_mask == 0;
+    }
+
+    // Returns true if both sets have a method in common
+    [[nodiscard]] constexpr bool intersects(MethodSet other) const {
+        return (m_mask & other.m_mask) != 0;
+    }
+
+    constexpr bool operator==(const MethodSet& other) const = default;
+
+private:
+    static_assert(Method::COUNT <= 16);
+
+    static constexpr std::uint16_t bit(Method::Id id) {
+        return id < Method::COUNT ? static_cast<std::uint16_t>(1u << id) : 0;
+    }
+
+    std::uint16_t m_mask = 0;
+};
+
+}
+
+template<>
+struct std::formatter<httc::Method> : std::formatter<std::string> {
+    auto format(const httc::Method& method, std::format_context& ctx) const {
+        return std::format_to(ctx.out(), "{}", method.name());
+    }
+};
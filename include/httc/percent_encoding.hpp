@@ -1,11 +1,34 @@
 #pragma once
 
+#include <cstddef>
 #include <optional>
 #include <string>
+#include <string_view>
 
 namespace httc {
 
-std::optional<std::string> percent_decode(const std::string& str);
-std::string percent_encode(const std::string& str);
+// Returns the decoded string, or std::nullopt if a '%' is not followed by two hex digits
+std::optional<std::string> percent_decode(std::string_view str);
+
+// Decodes `str` into `out`, which must have room for str.size() bytes. `out` may be str.data()
+// to decode in place. Returns the decoded size, or std::nullopt if the encoding is invalid
+std::optional<std::size_t> percent_decode(std::string_view str, char* out);
+
+// Decodes the `size` bytes at `str` in place. Returns the decoded size, or std::nullopt if the
+// encoding is invalid
+std::optional<std::size_t> percent_decode_in_place(char* str, std::size_t size);
+
+// Returns true if every '%' in `str` is followed by two hex digits
+bool valid_percent_encoding(std::string_view str);
+
+// Encodes every byte except the unreserved ones
+std::string percent_encode(std::string_view str);
+
+// Encodes `str` into `out`, which must have room for percent_encoded_size(str) bytes.
+// Returns the end of the output
+char* percent_encode(std::string_view str, char* out);
+
+// Returns the size of the encoding of `str`
+std::size_t percent_encoded_size(std::string_view str);
 
 }
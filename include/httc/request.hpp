@@ -2,13 +2,54 @@
 
 #include <format>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include "httc/body_reader.hpp"
 #include "httc/headers.hpp"
 #include "httc/io.hpp"
+#include "httc/method.hpp"
+#include "httc/small_vector.hpp"
 #include "httc/uri.hpp"
 
 namespace httc {
 
+// The :params of the route that handles a request, as views of the param names in the route and
+// of the segments of the request URI
+class PathParams {
+public:
+    using value_type = std::pair<std::string_view, std::string_view>;
+
+    [[nodiscard]] bool contains(std::string_view name) const;
+    // Throws std::out_of_range if there is no param with this name
+    [[nodiscard]] std::string_view at(std::string_view name) const;
+
+    std::size_t size() const {
+        return m_params.size();
+    }
+    bool empty() const {
+        return m_params.empty();
+    }
+    auto begin() const {
+        return m_params.begin();
+    }
+    auto end() const {
+        return m_params.end();
+    }
+
+    void add(std::string_view name, std::string_view value) {
+        m_params.push_back({ name, value });
+    }
+    void clear() {
+        m_params.clear();
+    }
+
+private:
+    static constexpr std::size_t INLINE_PARAMS = 8;
+
+    SmallVector<value_type, INLINE_PARAMS> m_params;
+};
+
 class Request {
 public:
     Request();
@@ -19,19 +60,24 @@ public:
     Request(Request&&) noexcept = default;
     Request& operator=(Request&&) noexcept = default;
 
-    std::string method;
+    Method method;
     URI uri;
     std::string body;
+    // Set instead of `body` for routes that stream their request body
+    BodyReader* body_reader = nullptr;
 
     Headers headers;
     Headers trailers;
     std::unordered_map<std::string_view, std::string_view> cookies;
 
-    std::string wildcard_path;
-    std::unordered_map<std::string, std::string> path_params;
+    // Set by the router, as views into the route and `uri`. They are only valid as long as the
+    // request is not moved and `uri` is not changed
+    std::string_view wildcard_path;
+    PathParams path_params;
 
 private:
     std::unique_ptr<char[]> m_raw_headers;
+    std::unique_ptr<char[]> m_raw_trailers;
 
     template<Reader R>
     friend class RequestParser;
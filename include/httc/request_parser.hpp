@@ -2,86 +2,216 @@
 
 #include <asio.hpp>
 #include <charconv>
+#include <cstring>
 #include <expected>
+#include <memory>
 #include <optional>
 #include <string_view>
+#include <vector>
+#include "httc/body_reader.hpp"
 #include "httc/headers.hpp"
+#include "httc/input_buffer.hpp"
 #include "httc/io.hpp"
 #include "httc/request.hpp"
+#include "httc/scan.hpp"
 #include "httc/status.hpp"
 #include "httc/validation.hpp"
 
 namespace httc {
 
-enum class RequestParserError {
-    READER_CLOSED,
-    INVALID_REQUEST_LINE,
-    INVALID_HEADER,
-    UNSUPPORTED_TRANSFER_ENCODING,
-    CONTENT_TOO_LARGE,
-    HEADER_TOO_LARGE,
-    INVALID_CHUNK_ENCODING,
-};
-
 StatusCode parse_error_to_status_code(RequestParserError error);
 
 using ParseResult = std::expected<Request, RequestParserError>;
 
+enum class ParseStatus {
+    NEED_MORE,
+    REQUEST_READY,
+    ERROR,
+};
+
+// The parsing itself never suspends: it runs on the data received so far and stops when it needs
+// more. The coroutines below only suspend to read from `R`, so requests that are already
+// buffered, like pipelined ones, are parsed without any suspension.
 template<Reader R = SocketReader>
 class RequestParser {
 public:
-    RequestParser(std::size_t max_headers_size, std::size_t max_body_size, R& reader);
+    // The input buffer holds at least max_headers_size bytes
+    RequestParser(
+        std::size_t max_headers_size, std::size_t max_body_size, R& reader,
+        std::size_t input_buffer_size = ServerConfig{}.input_buffer_size,
+        std::size_t max_header_count = ServerConfig{}.max_header_count
+    );
 
+    // Parses a complete request, including its body
     asio::awaitable<std::optional<ParseResult>> next();
 
+    // Parses a request up to the end of its headers. Its body must be read with read_body() or
+    // through body_reader() before parsing the next request
+    asio::awaitable<std::optional<ParseResult>> next_head();
+
+    // Reads the whole body of a request returned by next_head() into req.body
+    asio::awaitable<std::optional<RequestParserError>> read_body(Request& req);
+
+    // Returns a reader that streams the body of a request returned by next_head().
+    // Trailers are stored in `req`, which must stay in place until the body is read
+    BodyReader body_reader(Request& req);
+
+    // Returns the next piece of the body, without buffering it, or an empty view once the body
+    // is complete. The piece is valid until the next call
+    asio::awaitable<std::expected<std::string_view, RequestParserError>> read_body_piece();
+
+    // Parses `data` without reading from the reader.
+    // `data` must stay valid until this returns NEED_MORE, because body bytes are taken from it
+    // without being buffered. After REQUEST_READY, call take_request() and then feed() with no
+    // data to parse the requests that were received with it, until NEED_MORE is returned.
+    // Feeding more data before that buffers what is left of the earlier data
+    ParseStatus feed(std::string_view data);
+
+    // Takes the request once feed() returned REQUEST_READY
+    Request take_request();
+
+    // The error that made feed() return ERROR
+    RequestParserError error() const {
+        return m_error;
+    }
+
 private:
     enum class State {
         PARSE_REQUEST_LINE,
         PARSE_HEADERS,
         PARSE_BODY_CHUNKED_SIZE,
         PARSE_BODY_CHUNKED_DATA,
+        PARSE_BODY_CHUNK_END,
         PARSE_CHUNKED_TRAILERS,
         PARSE_BODY_CONTENT_LENGTH,
         PARSE_COMPLETE,
     };
 
-    asio::awaitable<std::optional<RequestParserError>> parse_request_line();
-    asio::awaitable<std::optional<RequestParserError>> parse_headers();
-    asio::awaitable<std::optional<RequestParserError>> prepare_parse_body();
-    asio::awaitable<std::optional<RequestParserError>> parse_body_content_length();
-    asio::awaitable<std::optional<RequestParserError>> parse_body_chunked_size();
-    asio::awaitable<std::optional<RequestParserError>> parse_body_chunked_data();
-    asio::awaitable<std::optional<RequestParserError>> parse_chunked_trailers();
+    // Where parse() returns REQUEST_READY
+    enum class Stop {
+        // After the headers
+        HEAD,
+        // At body data, which is then taken with take_body_piece()
+        BODY_DATA,
+        // After the whole request
+        REQUEST,
+    };
+
+    // Whether a step completed its state (true) or needs more data (false)
+    using StepResult = std::expected<bool, RequestParserError>;
+
+    // Runs the states on the received data until `stop`, moving the reader's data into the input
+    // buffer as needed. On NEED_MORE, m_overflow_error is the error to report if the input buffer
+    // cannot take more data
+    ParseStatus parse(Stop stop);
+
+    // Runs the current state
+    StepResult step();
+
+    StepResult parse_request_line();
+    StepResult parse_headers();
+    std::optional<RequestParserError> prepare_parse_body();
+    StepResult parse_body_data();
+    StepResult parse_body_chunked_size();
+    StepResult parse_body_chunk_end();
+    StepResult parse_chunked_trailers();
+
+    bool in_body_data() const {
+        return m_state == State::PARSE_BODY_CONTENT_LENGTH
+               || m_state == State::PARSE_BODY_CHUNKED_DATA;
+    }
+
+    // Moves on once the current Content-Length body or chunk has been read
+    void end_body_data();
+    // Gets ready for the next request once the body has been read
+    void end_body();
 
     void reset();
     void reset_err();
+    void fail(RequestParserError error);
 
     void advance_view(std::size_t n);
+    void rewind_scan_cursor();
+
+    // Moves as much of m_pending as fits into the input buffer. Returns false if nothing fits
+    bool buffer_pending();
+
+    // Receives more data from the reader, into the input buffer for a DirectReader and into
+    // m_pending otherwise. Fails with `overflow_error` if the input buffer is full.
+    // An empty input buffer gives its storage back first, and a WaitingReader waits for data
+    // before the storage is taken again
+    asio::awaitable<std::optional<RequestParserError>> pull(RequestParserError overflow_error);
+
+    // Moves up to m_body_bytes_remaining received bytes into the body, taking them from the
+    // input buffer first and then straight from the reader's data
+    void take_body_bytes();
+
+    // Receives more body bytes once the received ones have been taken. Large remainders are
+    // read straight into the body when the reader supports it
+    asio::awaitable<std::optional<RequestParserError>> pull_body();
+
+    // Takes up to m_body_bytes_remaining received bytes without copying them. The returned view is
+    // valid until the next pull
+    std::string_view take_body_piece();
 
-    std::optional<RequestParserError> add_cookies(std::string_view cookie_value);
+    std::optional<RequestParserError> add_cookies(std::string_view cookie_value, Request& req);
 
-    asio::awaitable<std::expected<std::size_t, RequestParserError>> pull_until(
-        std::string_view chars, std::size_t max_size,
+    // Returns the offset of the next CRLF in the view, or npos if more data is needed
+    std::expected<std::size_t, RequestParserError> find_line_end(
+        std::size_t max_size,
         RequestParserError overflow_error = RequestParserError::HEADER_TOO_LARGE
     );
 
-    asio::awaitable<std::optional<RequestParserError>>
-        parse_header(std::string_view header_line, Headers& target);
+    // Looks for a complete block of field lines in the view, recording every line end in
+    // m_line_ends. Returns the size of the block, including the empty line, or npos if more data
+    // is needed
+    std::expected<std::size_t, RequestParserError> find_header_block(std::size_t max_size);
+
+    // Copies a block of `block_size` bytes found by find_header_block into `storage` and parses
+    // each of its lines into `target`, and its cookies into `req`
+    std::optional<RequestParserError> parse_header_block(
+        std::size_t block_size, Headers& target, std::unique_ptr<char[]>& storage, Request& req
+    );
+
+    std::optional<RequestParserError>
+        parse_header(std::string_view header_line, Headers& target, Request& req);
 
 private:
     Request m_req;
+    // Request receiving the parsed body and trailers. Points to m_req, except while the body of a
+    // request returned by next_head() is read
+    Request* m_target = &m_req;
     State m_state;
 
-    std::string m_buffer;
+    RequestParserError m_error = RequestParserError::READER_CLOSED;
+    RequestParserError m_overflow_error = RequestParserError::HEADER_TOO_LARGE;
+
+    InputBuffer m_input;
+    // Received bytes that were not moved into m_input yet.
+    // Valid until the next pull from the reader. Always empty for a DirectReader
+    std::string_view m_pending;
 
+    // Unread bytes of m_input
     std::string_view m_view;
-    std::size_t m_view_start = 0;
 
-    std::size_t m_chunk_bytes_remaining;
+    // Offset in the view where the current delimiter search resumes after more data is pulled,
+    // so bytes that arrive in many small pieces are only scanned once
+    std::size_t m_scan_cursor = 0;
+
+    // Bytes left in the Content-Length body or in the current chunk
+    std::size_t m_body_bytes_remaining;
+    // Body bytes announced so far by chunk sizes
+    std::size_t m_chunked_body_size = 0;
+
+    // CRLF offsets of the header block being parsed, relative to the start of the view.
+    // Kept across pulls together with m_scan_cursor
+    std::vector<std::size_t> m_line_ends;
 
     std::size_t m_max_headers_size;
     // Current headers size, including request line and CRLFs
     std::size_t m_current_headers_size;
+    // Fields allowed in one header or trailer block
+    std::size_t m_max_header_count;
     std::size_t m_max_body_size;
 
     R& m_reader;
@@ -92,70 +222,257 @@ private:
 namespace httc {
 
 template<Reader R>
-RequestParser<R>::RequestParser(std::size_t max_headers_size, std::size_t max_body_size, R& reader)
-: m_max_headers_size(max_headers_size), m_max_body_size(max_body_size), m_reader(reader) {
+RequestParser<R>::RequestParser(
+    std::size_t max_headers_size, std::size_t max_body_size, R& reader,
+    std::size_t input_buffer_size, std::size_t max_header_count
+)
+: m_input(std::max(input_buffer_size, max_headers_size)), m_max_headers_size(max_headers_size),
+  m_max_header_count(max_header_count), m_max_body_size(max_body_size), m_reader(reader) {
     m_state = State::PARSE_REQUEST_LINE;
     m_current_headers_size = 0;
 }
 
 template<Reader R>
 asio::awaitable<std::optional<ParseResult>> RequestParser<R>::next() {
-    while (m_state != State::PARSE_COMPLETE) {
-        std::optional<RequestParserError> result;
+    while (true) {
+        auto status = parse(Stop::REQUEST);
+        if (status == ParseStatus::REQUEST_READY) {
+            co_return take_request();
+        } else if (status == ParseStatus::ERROR) {
+            co_return std::unexpected(m_error);
+        }
 
-        switch (m_state) {
-        case State::PARSE_REQUEST_LINE:
-            result = co_await parse_request_line();
-            break;
-        case State::PARSE_HEADERS:
-            result = co_await parse_headers();
-            break;
-        case State::PARSE_BODY_CHUNKED_SIZE:
-            result = co_await parse_body_chunked_size();
-            break;
-        case State::PARSE_BODY_CHUNKED_DATA:
-            result = co_await parse_body_chunked_data();
-            break;
-        case State::PARSE_CHUNKED_TRAILERS:
-            result = co_await parse_chunked_trailers();
-            break;
-        case State::PARSE_BODY_CONTENT_LENGTH:
-            result = co_await parse_body_content_length();
-            break;
-        default:
-            break;
+        std::optional<RequestParserError> err;
+        if (in_body_data()) {
+            err = co_await pull_body();
+        } else {
+            err = co_await pull(m_overflow_error);
         }
 
-        if (result.has_value()) {
+        if (err.has_value()) {
             reset_err();
 
             // If the reader is closed, return nullopt to indicate end of stream
-            if (*result == RequestParserError::READER_CLOSED) {
+            if (*err == RequestParserError::READER_CLOSED) {
                 co_return std::nullopt;
             } else {
-                co_return std::unexpected(*result);
+                co_return std::unexpected(*err);
             }
         }
     }
+}
+
+template<Reader R>
+asio::awaitable<std::optional<ParseResult>> RequestParser<R>::next_head() {
+    // The previous request may be gone already
+    m_target = &m_req;
+    while (true) {
+        auto status = parse(Stop::HEAD);
+        if (status == ParseStatus::REQUEST_READY) {
+            break;
+        } else if (status == ParseStatus::ERROR) {
+            co_return std::unexpected(m_error);
+        }
 
-    m_buffer.erase(0, m_view_start);
-    m_view_start = 0;
-    m_view = std::string_view(m_buffer.data(), m_buffer.size());
+        auto err = co_await pull(m_overflow_error);
+        if (err.has_value()) {
+            reset_err();
+
+            // If the reader is closed, return nullopt to indicate end of stream
+            if (*err == RequestParserError::READER_CLOSED) {
+                co_return std::nullopt;
+            } else {
+                co_return std::unexpected(*err);
+            }
+        }
+    }
 
     auto req = std::move(m_req);
     reset();
+    if (m_state == State::PARSE_COMPLETE) {
+        // No body
+        end_body();
+    }
     co_return req;
 }
 
 template<Reader R>
-asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::parse_request_line() {
+asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::read_body(Request& req) {
+    if (m_state == State::PARSE_REQUEST_LINE) {
+        // No body, or already read
+        co_return std::nullopt;
+    }
+
+    m_target = &req;
+    while (true) {
+        auto status = parse(Stop::REQUEST);
+        if (status == ParseStatus::REQUEST_READY) {
+            break;
+        } else if (status == ParseStatus::ERROR) {
+            co_return m_error;
+        }
+
+        std::optional<RequestParserError> err;
+        if (in_body_data()) {
+            err = co_await pull_body();
+        } else {
+            err = co_await pull(m_overflow_error);
+        }
+
+        if (err.has_value()) {
+            reset_err();
+            co_return err;
+        }
+    }
+
+    end_body();
+    co_return std::nullopt;
+}
+
+template<Reader R>
+BodyReader RequestParser<R>::body_reader(Request& req) {
+    // Without a body, nothing is ever stored in `req`
+    if (m_state != State::PARSE_REQUEST_LINE) {
+        m_target = &req;
+    }
+    return BodyReader(*this);
+}
+
+template<Reader R>
+asio::awaitable<std::expected<std::string_view, RequestParserError>>
+    RequestParser<R>::read_body_piece() {
+    if (m_state == State::PARSE_REQUEST_LINE) {
+        // No body, or already read
+        co_return std::string_view();
+    }
+
+    while (true) {
+        auto status = parse(Stop::BODY_DATA);
+        if (status == ParseStatus::ERROR) {
+            co_return std::unexpected(m_error);
+        }
+
+        auto overflow_error = m_overflow_error;
+        if (status == ParseStatus::REQUEST_READY) {
+            if (m_state == State::PARSE_COMPLETE) {
+                break;
+            }
+
+            auto piece = take_body_piece();
+            if (!piece.empty()) {
+                co_return piece;
+            }
+            if (m_body_bytes_remaining == 0) {
+                end_body_data();
+                continue;
+            }
+
+            // Only the next piece is received, so a slow handler slows down the client
+            overflow_error = RequestParserError::CONTENT_TOO_LARGE;
+        }
+
+        auto err = co_await pull(overflow_error);
+        if (err.has_value()) {
+            reset_err();
+            co_return std::unexpected(*err);
+        }
+    }
+
+    end_body();
+    co_return std::string_view();
+}
+
+template<Reader R>
+ParseStatus RequestParser<R>::feed(std::string_view data) {
+    // Bytes of an earlier call that were not parsed yet come first, so they are buffered before
+    // `data` replaces them
+    if (!data.empty()) {
+        while (!m_pending.empty()) {
+            if (!buffer_pending()) {
+                fail(m_overflow_error);
+                return ParseStatus::ERROR;
+            }
+        }
+        m_pending = data;
+    }
+    return parse(Stop::REQUEST);
+}
+
+template<Reader R>
+Request RequestParser<R>::take_request() {
+    auto req = std::move(m_req);
+    reset();
+    end_body();
+    return req;
+}
+
+template<Reader R>
+ParseStatus RequestParser<R>::parse(Stop stop) {
+    while (m_state != State::PARSE_COMPLETE) {
+        if (stop == Stop::HEAD && m_state != State::PARSE_REQUEST_LINE
+            && m_state != State::PARSE_HEADERS) {
+            break;
+        }
+        if (stop == Stop::BODY_DATA && in_body_data()) {
+            break;
+        }
+
+        auto result = step();
+        if (!result.has_value()) {
+            fail(result.error());
+            return ParseStatus::ERROR;
+        }
+        if (*result) {
+            continue;
+        }
+
+        // Body data is taken straight from m_pending, so there is only something to buffer while
+        // looking for delimiters
+        if (m_pending.empty()) {
+            return ParseStatus::NEED_MORE;
+        }
+        if (!buffer_pending()) {
+            fail(m_overflow_error);
+            return ParseStatus::ERROR;
+        }
+    }
+
+    return ParseStatus::REQUEST_READY;
+}
+
+template<Reader R>
+RequestParser<R>::StepResult RequestParser<R>::step() {
+    switch (m_state) {
+    case State::PARSE_REQUEST_LINE:
+        return parse_request_line();
+    case State::PARSE_HEADERS:
+        return parse_headers();
+    case State::PARSE_BODY_CHUNKED_SIZE:
+        return parse_body_chunked_size();
+    case State::PARSE_BODY_CHUNKED_DATA:
+    case State::PARSE_BODY_CONTENT_LENGTH:
+        return parse_body_data();
+    case State::PARSE_BODY_CHUNK_END:
+        return parse_body_chunk_end();
+    case State::PARSE_CHUNKED_TRAILERS:
+        return parse_chunked_trailers();
+    default:
+        return true;
+    }
+}
+
+template<Reader R>
+RequestParser<R>::StepResult RequestParser<R>::parse_request_line() {
     std::size_t crlf;
     while (true) {
-        auto crlf_res = co_await pull_until("\r\n", m_max_headers_size);
+        auto crlf_res = find_line_end(m_max_headers_size);
         if (!crlf_res.has_value()) {
-            co_return crlf_res.error();
+            return std::unexpected(crlf_res.error());
         }
         crlf = crlf_res.value();
+        if (crlf == std::string_view::npos) {
+            return false;
+        }
 
         if (crlf == 0) {
             // https://www.rfc-editor.org/rfc/rfc9112.html#section-2.2-6
@@ -171,133 +488,153 @@ asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::parse_reque
 
     m_current_headers_size += request_line.size() + 2;
     if (m_current_headers_size > m_max_headers_size) {
-        co_return RequestParserError::HEADER_TOO_LARGE;
+        return std::unexpected(RequestParserError::HEADER_TOO_LARGE);
     }
 
     auto method_end = request_line.find(' ');
     if (method_end == std::string::npos) {
-        co_return RequestParserError::INVALID_REQUEST_LINE;
+        return std::unexpected(RequestParserError::INVALID_REQUEST_LINE);
     }
-    m_req.method = request_line.substr(0, method_end);
-    if (!valid_token(m_req.method)) {
-        co_return RequestParserError::INVALID_REQUEST_LINE;
+    auto method = request_line.substr(0, method_end);
+    m_req.method = Method(method);
+    // Standard methods are valid tokens already
+    if (m_req.method.id() == Method::OTHER && !valid_token(method)) {
+        return std::unexpected(RequestParserError::INVALID_REQUEST_LINE);
     }
 
     auto uri_start = method_end + 1;
     auto uri_end = request_line.find(' ', uri_start);
     if (uri_end == std::string::npos) {
-        co_return RequestParserError::INVALID_REQUEST_LINE;
+        return std::unexpected(RequestParserError::INVALID_REQUEST_LINE);
     }
 
     auto uri_str = request_line.substr(uri_start, uri_end - uri_start);
     auto uri = URI::parse(uri_str);
     if (!uri.has_value()) {
-        co_return RequestParserError::INVALID_REQUEST_LINE;
+        return std::unexpected(RequestParserError::INVALID_REQUEST_LINE);
     }
-    m_req.uri = *uri;
+    m_req.uri = std::move(*uri);
 
     auto version_start = uri_end + 1;
     auto version = request_line.substr(version_start);
     if (version != "HTTP/1.1") {
-        co_return RequestParserError::INVALID_REQUEST_LINE;
+        return std::unexpected(RequestParserError::INVALID_REQUEST_LINE);
     }
 
     // Remove the request line and CRLF from the buffer
     advance_view(crlf + 2);
     m_state = State::PARSE_HEADERS;
 
-    co_return std::nullopt;
+    return true;
 }
 
 template<Reader R>
-asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::parse_headers() {
-    auto first_header_end_res =
-        co_await pull_until("\r\n", m_max_headers_size - m_current_headers_size);
-    if (!first_header_end_res.has_value()) {
-        co_return first_header_end_res.error();
+RequestParser<R>::StepResult RequestParser<R>::parse_headers() {
+    auto block_size_res = find_header_block(m_max_headers_size - m_current_headers_size);
+    if (!block_size_res.has_value()) {
+        return std::unexpected(block_size_res.error());
     }
-    if (*first_header_end_res == 0) {
+    auto block_size = block_size_res.value();
+    if (block_size == std::string_view::npos) {
+        return false;
+    }
+
+    if (block_size == 2) {
         // No headers
         advance_view(2);
-        co_return co_await prepare_parse_body();
-    }
+    } else {
+        m_current_headers_size += block_size;
+        if (m_current_headers_size > m_max_headers_size) {
+            return std::unexpected(RequestParserError::HEADER_TOO_LARGE);
+        }
 
-    auto headers_end_res =
-        co_await pull_until("\r\n\r\n", m_max_headers_size - m_current_headers_size);
-    if (!headers_end_res.has_value()) {
-        co_return headers_end_res.error();
+        auto result =
+            parse_header_block(block_size, m_req.headers, m_req.m_raw_headers, m_req);
+        if (result.has_value()) {
+            return std::unexpected(*result);
+        }
     }
-    auto headers_end = headers_end_res.value();
-
-    // Copy the raw header string in the request for storing refrences to it in the headers map
-    m_req.m_raw_headers = std::make_unique<char[]>(headers_end + 4);
-    std::memcpy(m_req.m_raw_headers.get(), m_view.data(), headers_end + 4);
-    auto headers = std::string_view(m_req.m_raw_headers.get(), headers_end + 4);
-
-    advance_view(headers_end + 4);
 
-    m_current_headers_size += headers.size();
-    if (m_current_headers_size > m_max_headers_size) {
-        co_return RequestParserError::HEADER_TOO_LARGE;
+    auto result = prepare_parse_body();
+    if (result.has_value()) {
+        return std::unexpected(*result);
     }
+    return true;
+}
 
-    while (true) {
-        auto newline = headers.find("\r\n");
-        auto header_lines = headers.substr(0, newline);
-        headers = headers.substr(newline + 2);
-
-        // End of headers
-        if (header_lines.empty()) {
-            co_return co_await prepare_parse_body();
-        }
+template<Reader R>
+RequestParser<R>::StepResult RequestParser<R>::parse_chunked_trailers() {
+    auto block_size_res = find_header_block(m_max_headers_size);
+    if (!block_size_res.has_value()) {
+        return std::unexpected(block_size_res.error());
+    }
+    auto block_size = block_size_res.value();
+    if (block_size == std::string_view::npos) {
+        return false;
+    }
 
-        auto result = co_await parse_header(header_lines, m_req.headers);
+    if (block_size == 2) {
+        // No trailers
+        advance_view(2);
+        m_state = State::PARSE_COMPLETE;
+        return true;
+    }
 
-        if (result.has_value()) {
-            co_return result;
-        }
+    auto result = parse_header_block(
+        block_size, m_target->trailers, m_target->m_raw_trailers, *m_target
+    );
+    if (result.has_value()) {
+        return std::unexpected(*result);
     }
+
+    m_state = State::PARSE_COMPLETE;
+    return true;
 }
 
 template<Reader R>
-asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::parse_chunked_trailers() {
-    while (!m_view.empty()) {
-        auto crlf_res = co_await pull_until("\r\n", m_max_headers_size);
-        if (!crlf_res.has_value()) {
-            co_return crlf_res.error();
-        }
-        auto crlf = crlf_res.value();
+std::optional<RequestParserError> RequestParser<R>::parse_header_block(
+    std::size_t block_size, Headers& target, std::unique_ptr<char[]>& storage, Request& req
+) {
+    // Every line end but the one of the empty line is a field. Checked before any is inserted
+    if (m_line_ends.size() - 1 > m_max_header_count) {
+        return RequestParserError::TOO_MANY_HEADERS;
+    }
 
-        std::string_view header_line = m_view.substr(0, crlf);
+    // Copy the raw block in the request for storing refrences to it in the headers map
+    storage = std::make_unique<char[]>(block_size);
+    std::memcpy(storage.get(), m_view.data(), block_size);
+    auto block = std::string_view(storage.get(), block_size);
 
-        // End of trailers
-        if (header_line.empty()) {
-            advance_view(crlf + 2);
-            m_state = State::PARSE_COMPLETE;
-            co_return std::nullopt;
+    std::size_t line_start = 0;
+    for (auto line_end : m_line_ends) {
+        // End of block
+        if (line_end == line_start) {
+            break;
         }
 
-        auto result = co_await parse_header(header_line, m_req.trailers);
-        advance_view(crlf + 2);
-
+        auto result =
+            parse_header(block.substr(line_start, line_end - line_start), target, req);
         if (result.has_value()) {
-            co_return result;
+            return result;
         }
+        line_start = line_end + 2;
     }
 
-    co_return std::nullopt;
+    // Also clears m_line_ends
+    advance_view(block_size);
+    return std::nullopt;
 }
 
 template<Reader R>
-asio::awaitable<std::optional<RequestParserError>>
-    RequestParser<R>::parse_header(std::string_view header_line, Headers& target) {
+std::optional<RequestParserError>
+    RequestParser<R>::parse_header(std::string_view header_line, Headers& target, Request& req) {
     auto colon_pos = header_line.find(':');
     if (colon_pos == std::string::npos) {
-        co_return RequestParserError::INVALID_HEADER;
+        return RequestParserError::INVALID_HEADER;
     }
     std::string_view name = header_line.substr(0, colon_pos);
     if (!valid_token(name)) {
-        co_return RequestParserError::INVALID_HEADER;
+        return RequestParserError::INVALID_HEADER;
     }
 
     // Skip the colon and optional spaces
@@ -314,160 +651,187 @@ asio::awaitable<std::optional<RequestParserError>>
     }
 
     if (name == "Cookie") {
-        if (!valid_header_value(value)) {
-            co_return RequestParserError::INVALID_HEADER;
-        }
-
-        co_return add_cookies(value);
+        // Cookie values are a subset of header values, so they are only validated as cookies
+        return add_cookies(value, req);
     }
 
-    try {
-        target.set_view(name, value);
-    } catch (const std::invalid_argument& e) {
-        co_return RequestParserError::INVALID_HEADER;
+    if (!valid_header_value(value)) {
+        return RequestParserError::INVALID_HEADER;
     }
-    co_return std::nullopt;
+
+    // Both were validated above
+    target.set_view_unchecked(name, value);
+    return std::nullopt;
 }
 
 template<Reader R>
-asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::prepare_parse_body() {
-    auto encoding_opt = m_req.headers.get_one("Transfer-Encoding");
-    auto content_length_opt = m_req.headers.get_one("Content-Length");
+std::optional<RequestParserError> RequestParser<R>::prepare_parse_body() {
+    auto encoding_opt = m_req.headers.get_one(Header::TRANSFER_ENCODING);
+    auto content_length_opt = m_req.headers.get_one(Header::CONTENT_LENGTH);
 
     // Both Content-Length and Transfer-Encoding present
     if (content_length_opt.has_value() && encoding_opt.has_value()) {
-        co_return RequestParserError::INVALID_HEADER;
+        return RequestParserError::INVALID_HEADER;
     }
 
     if (encoding_opt.has_value()) {
         // Only chunked encoding is supported
         if (*encoding_opt != "chunked") {
-            co_return RequestParserError::UNSUPPORTED_TRANSFER_ENCODING;
+            return RequestParserError::UNSUPPORTED_TRANSFER_ENCODING;
         }
 
+        m_chunked_body_size = 0;
         m_state = State::PARSE_BODY_CHUNKED_SIZE;
     } else if (content_length_opt.has_value()) {
+        std::size_t content_length = 0;
+        auto res = std::from_chars(
+            content_length_opt->data(), content_length_opt->data() + content_length_opt->size(),
+            content_length
+        );
+        if (res.ec != std::errc()) {
+            return RequestParserError::INVALID_HEADER;
+        }
+        if (content_length > m_max_body_size) {
+            return RequestParserError::CONTENT_TOO_LARGE;
+        }
+
+        m_body_bytes_remaining = content_length;
         m_state = State::PARSE_BODY_CONTENT_LENGTH;
     } else {
         // No body
         m_state = State::PARSE_COMPLETE;
     }
 
-    co_return std::nullopt;
+    return std::nullopt;
 }
 
 template<Reader R>
-asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::parse_body_content_length() {
-    // We know Content-Length is present because of the state machine
-    auto content_length_sv = *m_req.headers.get_one("Content-Length");
-    std::size_t content_length = 0;
-
-    auto res = std::from_chars(
-        content_length_sv.data(), content_length_sv.data() + content_length_sv.size(),
-        content_length
-    );
-    if (res.ec != std::errc()) {
-        co_return RequestParserError::INVALID_HEADER;
-    }
-    if (content_length > m_max_body_size) {
-        co_return RequestParserError::CONTENT_TOO_LARGE;
+RequestParser<R>::StepResult RequestParser<R>::parse_body_data() {
+    if (m_state == State::PARSE_BODY_CONTENT_LENGTH) {
+        // The body gets its own allocation of the exact size, whatever the input buffer holds
+        m_target->body.reserve(m_target->body.size() + m_body_bytes_remaining);
     }
 
-    while (m_view.size() < content_length) {
-        auto data_opt = co_await m_reader.pull();
-        if (!data_opt.has_value()) {
-            co_return RequestParserError::READER_CLOSED;
-        }
-        m_buffer.append(*data_opt);
-        m_view = std::string_view(m_buffer.data() + m_view_start, m_buffer.size() - m_view_start);
+    take_body_bytes();
+    if (m_body_bytes_remaining > 0) {
+        m_overflow_error = RequestParserError::CONTENT_TOO_LARGE;
+        return false;
     }
 
-    m_req.body = m_view.substr(0, content_length);
-    advance_view(content_length);
-    m_state = State::PARSE_COMPLETE;
-    co_return std::nullopt;
+    end_body_data();
+    return true;
 }
 
 template<Reader R>
-asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::parse_body_chunked_size() {
-    auto crlf_res = co_await pull_until("\r\n", 1024, RequestParserError::INVALID_CHUNK_ENCODING);
+RequestParser<R>::StepResult RequestParser<R>::parse_body_chunked_size() {
+    auto crlf_res = find_line_end(1024, RequestParserError::INVALID_CHUNK_ENCODING);
     if (!crlf_res.has_value()) {
-        co_return crlf_res.error();
+        return std::unexpected(crlf_res.error());
     }
     auto crlf = crlf_res.value();
+    if (crlf == std::string_view::npos) {
+        return false;
+    }
 
     std::string_view size_line = m_view.substr(0, crlf);
     std::size_t chunk_size = 0;
     auto res =
         std::from_chars(size_line.data(), size_line.data() + size_line.size(), chunk_size, 16);
     if (res.ec != std::errc()) {
-        co_return RequestParserError::INVALID_CHUNK_ENCODING;
+        return std::unexpected(RequestParserError::INVALID_CHUNK_ENCODING);
     }
-    if (chunk_size > m_max_body_size || m_req.body.size() + chunk_size > m_max_body_size) {
-        co_return RequestParserError::CONTENT_TOO_LARGE;
+    if (chunk_size > m_max_body_size - m_chunked_body_size) {
+        return std::unexpected(RequestParserError::CONTENT_TOO_LARGE);
     }
+    m_chunked_body_size += chunk_size;
 
-    m_chunk_bytes_remaining = chunk_size;
-    m_state = State::PARSE_BODY_CHUNKED_DATA;
     advance_view(crlf + 2);
 
-    co_return std::nullopt;
-}
-
-template<Reader R>
-asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::parse_body_chunked_data() {
-    while (m_view.size() < m_chunk_bytes_remaining + 2) {
-        auto data_opt = co_await m_reader.pull();
-        if (!data_opt.has_value()) {
-            co_return RequestParserError::READER_CLOSED;
-        }
-        m_buffer.append(*data_opt);
-        m_view = std::string_view(m_buffer.data() + m_view_start, m_buffer.size() - m_view_start);
-    }
-
     // Last chunk
-    if (m_chunk_bytes_remaining == 0) {
+    if (chunk_size == 0) {
         m_state = State::PARSE_CHUNKED_TRAILERS;
-        co_return std::nullopt;
+        return true;
     }
 
-    m_req.body.append(m_view.substr(0, m_chunk_bytes_remaining));
-    advance_view(m_chunk_bytes_remaining);
-    m_chunk_bytes_remaining = 0;
+    m_body_bytes_remaining = chunk_size;
+    m_state = State::PARSE_BODY_CHUNKED_DATA;
+    return true;
+}
 
+template<Reader R>
+RequestParser<R>::StepResult RequestParser<R>::parse_body_chunk_end() {
     // Expecting CRLF after chunk data
+    if (m_view.size() < 2) {
+        m_overflow_error = RequestParserError::INVALID_CHUNK_ENCODING;
+        return false;
+    }
     if (!m_view.starts_with("\r\n")) {
-        co_return RequestParserError::INVALID_CHUNK_ENCODING;
+        return std::unexpected(RequestParserError::INVALID_CHUNK_ENCODING);
     }
     advance_view(2);
 
     m_state = State::PARSE_BODY_CHUNKED_SIZE;
-    co_return std::nullopt;
+    return true;
+}
+
+template<Reader R>
+void RequestParser<R>::end_body_data() {
+    if (m_state == State::PARSE_BODY_CONTENT_LENGTH) {
+        m_state = State::PARSE_COMPLETE;
+    } else {
+        m_state = State::PARSE_BODY_CHUNK_END;
+    }
+}
+
+template<Reader R>
+void RequestParser<R>::end_body() {
+    m_state = State::PARSE_REQUEST_LINE;
+    m_target = &m_req;
 }
 
 template<Reader R>
 void RequestParser<R>::reset() {
     m_req = Request();
-    m_state = State::PARSE_REQUEST_LINE;
+    m_target = &m_req;
     m_current_headers_size = 0;
 }
 
 template<Reader R>
 void RequestParser<R>::reset_err() {
     reset();
-    m_buffer = {};
+    m_state = State::PARSE_REQUEST_LINE;
+    m_input.clear();
+    m_pending = {};
     m_view = {};
-    m_view_start = 0;
+    m_scan_cursor = 0;
+    m_line_ends.clear();
+}
+
+template<Reader R>
+void RequestParser<R>::fail(RequestParserError error) {
+    m_error = error;
+    reset_err();
 }
 
 template<Reader R>
 void RequestParser<R>::advance_view(std::size_t n) {
-    m_view_start += n;
-    m_view = std::string_view(m_buffer.data() + m_view_start, m_buffer.size() - m_view_start);
+    m_input.consume(n);
+    m_view = m_input.data();
+
+    // Consuming data ends the current search
+    m_scan_cursor = 0;
+    m_line_ends.clear();
+}
+
+template<Reader R>
+void RequestParser<R>::rewind_scan_cursor() {
+    // A CR in the last byte may still be followed by a LF in the next pull
+    m_scan_cursor = m_view.empty() ? 0 : m_view.size() - 1;
 }
 
 template<Reader R>
-std::optional<RequestParserError> RequestParser<R>::add_cookies(std::string_view cookie_value) {
+std::optional<RequestParserError>
+    RequestParser<R>::add_cookies(std::string_view cookie_value, Request& req) {
     for (;;) {
         auto semicolon_pos = cookie_value.find(';');
         std::string_view cookie_pair;
@@ -476,7 +840,10 @@ std::optional<RequestParserError> RequestParser<R>::add_cookies(std::string_view
             cookie_value = "";
         } else {
             cookie_pair = cookie_value.substr(0, semicolon_pos);
-            // Skip semicolon and space
+            // Skip semicolon and space. Every other byte is validated as part of a cookie pair
+            if (cookie_value.substr(semicolon_pos + 1, 1) != " ") {
+                return RequestParserError::INVALID_HEADER;
+            }
             cookie_value = cookie_value.substr(semicolon_pos + 2);
         }
 
@@ -492,7 +859,7 @@ std::optional<RequestParserError> RequestParser<R>::add_cookies(std::string_view
             return RequestParserError::INVALID_HEADER;
         }
 
-        m_req.cookies.emplace(name, value);
+        req.cookies.emplace(name, value);
 
         if (cookie_value.empty()) {
             return std::nullopt;
@@ -501,27 +868,144 @@ std::optional<RequestParserError> RequestParser<R>::add_cookies(std::string_view
 }
 
 template<Reader R>
-asio::awaitable<std::expected<std::size_t, RequestParserError>> RequestParser<R>::pull_until(
-    std::string_view chars, std::size_t max_size, RequestParserError overflow_error
-) {
-    while (true) {
-        auto crlf = m_view.find(chars);
-        if (crlf != std::string::npos) {
-            co_return crlf;
+std::expected<std::size_t, RequestParserError>
+    RequestParser<R>::find_line_end(std::size_t max_size, RequestParserError overflow_error) {
+    auto crlf = find_crlf(m_view, m_scan_cursor);
+    if (crlf != std::string::npos) {
+        return crlf;
+    }
+    rewind_scan_cursor();
+
+    if (m_view.size() > max_size) {
+        return std::unexpected(overflow_error);
+    }
+    m_overflow_error = overflow_error;
+    return std::string_view::npos;
+}
+
+template<Reader R>
+std::expected<std::size_t, RequestParserError>
+    RequestParser<R>::find_header_block(std::size_t max_size) {
+    auto block_size = scan_header_lines(m_view, m_scan_cursor, m_line_ends);
+    if (block_size != std::string::npos) {
+        return block_size;
+    }
+    rewind_scan_cursor();
+
+    if (m_view.size() > max_size) {
+        return std::unexpected(RequestParserError::HEADER_TOO_LARGE);
+    }
+    m_overflow_error = RequestParserError::HEADER_TOO_LARGE;
+    return std::string_view::npos;
+}
+
+template<Reader R>
+bool RequestParser<R>::buffer_pending() {
+    auto n = m_input.append(m_pending);
+    if (n == 0) {
+        return false;
+    }
+    m_pending.remove_prefix(n);
+    m_view = m_input.data();
+    return true;
+}
+
+template<Reader R>
+asio::awaitable<std::optional<RequestParserError>>
+    RequestParser<R>::pull(RequestParserError overflow_error) {
+    // Everything received was consumed, so the storage goes back to the pool while waiting
+    if (m_input.empty()) {
+        m_input.release();
+        m_view = {};
+    }
+
+    if constexpr (DirectReader<R>) {
+        if constexpr (WaitingReader<R>) {
+            if (!m_input.holds_storage()) {
+                auto ready = co_await m_reader.wait();
+                if (!ready.has_value()) {
+                    co_return RequestParserError::READER_CLOSED;
+                }
+            }
         }
 
-        if (m_view.size() > max_size) {
-            co_return std::unexpected(overflow_error);
+        auto free = m_input.prepare();
+        if (free.empty()) {
+            co_return overflow_error;
         }
 
+        auto n = co_await m_reader.pull_into(free);
+        if (!n.has_value()) {
+            co_return RequestParserError::READER_CLOSED;
+        }
+        m_input.commit(*n);
+        m_view = m_input.data();
+    } else {
         auto data_opt = co_await m_reader.pull();
         if (!data_opt.has_value()) {
-            co_return std::unexpected(RequestParserError::READER_CLOSED);
+            co_return RequestParserError::READER_CLOSED;
         }
+        m_pending = *data_opt;
+    }
 
-        m_buffer.append(*data_opt);
-        m_view = std::string_view(m_buffer.data() + m_view_start, m_buffer.size() - m_view_start);
+    co_return std::nullopt;
+}
+
+template<Reader R>
+void RequestParser<R>::take_body_bytes() {
+    auto n = std::min(m_view.size(), m_body_bytes_remaining);
+    m_target->body.append(m_view.substr(0, n));
+    advance_view(n);
+    m_body_bytes_remaining -= n;
+
+    // Large bodies skip the input buffer
+    n = std::min(m_pending.size(), m_body_bytes_remaining);
+    m_target->body.append(m_pending.substr(0, n));
+    m_pending.remove_prefix(n);
+    m_body_bytes_remaining -= n;
+}
+
+template<Reader R>
+asio::awaitable<std::optional<RequestParserError>> RequestParser<R>::pull_body() {
+    if constexpr (DirectReader<R>) {
+        // Small remainders go through the input buffer, which may also pick up the next request
+        if (m_body_bytes_remaining < m_input.capacity()) {
+            co_return co_await pull(RequestParserError::CONTENT_TOO_LARGE);
+        }
+
+        auto& body = m_target->body;
+        auto offset = body.size();
+        body.resize_and_overwrite(offset + m_body_bytes_remaining, [](char*, std::size_t n) {
+            return n;
+        });
+        auto n =
+            co_await m_reader.pull_into(std::span(body.data() + offset, m_body_bytes_remaining));
+        body.resize(offset + n.value_or(0));
+        if (!n.has_value()) {
+            co_return RequestParserError::READER_CLOSED;
+        }
+
+        m_body_bytes_remaining -= *n;
+        co_return std::nullopt;
+    } else {
+        co_return co_await pull(RequestParserError::CONTENT_TOO_LARGE);
+    }
+}
+
+template<Reader R>
+std::string_view RequestParser<R>::take_body_piece() {
+    std::string_view piece;
+    if (!m_view.empty()) {
+        piece = m_view.substr(0, std::min(m_view.size(), m_body_bytes_remaining));
+        // The consumed bytes stay in place until the next pull
+        advance_view(piece.size());
+    } else {
+        piece = m_pending.substr(0, std::min(m_pending.size(), m_body_bytes_remaining));
+        m_pending.remove_prefix(piece.size());
     }
+
+    m_body_bytes_remaining -= piece.size();
+    return piece;
 }
 
 }
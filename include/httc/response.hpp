@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <asio/stream_file.hpp>
+#include <cstdint>
 #include "httc/headers.hpp"
 #include "httc/io.hpp"
 #include "httc/status.hpp"
@@ -7,29 +10,51 @@
 namespace httc {
 
 class Response {
-    using WriteFn = asio::awaitable<void>(*)(void*, std::vector<asio::const_buffer>);
+    using WriteFn = asio::awaitable<void>(*)(void*, WriteBuffers);
+    using FlushFn = asio::awaitable<void>(*)(void*);
+    using SendFileFn = asio::awaitable<void>(*)(void*, int, std::uint64_t, std::size_t);
 
 public:
     template<Writer W>
     Response(W& writer, bool is_head_response = false)
     : m_writer_ptr(&writer),
-      m_write_fn([](void* w, std::vector<asio::const_buffer> b) -> asio::awaitable<void> {
-          return static_cast<W*>(w)->write(std::move(b));
+      m_write_fn([](void* w, WriteBuffers b) -> asio::awaitable<void> {
+          return static_cast<W*>(w)->write(b);
       }),
       m_head(is_head_response) {
+        if constexpr (FlushableWriter<W>) {
+            m_flush_fn = [](void* w) -> asio::awaitable<void> {
+                return static_cast<W*>(w)->flush();
+            };
+        }
+        if constexpr (FileWriter<W>) {
+            m_send_file_fn = [](void* w, int fd, std::uint64_t offset, std::size_t size) {
+                return static_cast<W*>(w)->send_file(fd, offset, size);
+            };
+        }
         status = StatusCode::OK;
         headers.set("Content-Length", "0");
         m_state = State::Uninitialized;
     }
 
-    static Response from_status(SocketWriter& writer, StatusCode status);
+    template<Writer W>
+    static Response from_status(W& writer, StatusCode status) {
+        Response r(writer);
+        r.status = status;
+        return r;
+    }
 
+    // Stream writes, with their framing, are held back by the connection until its output buffer
+    // fills, the handler waits on something, or flush() is called. Small writes go out together
     class ChunkedStream {
     public:
-        // If the chunk is not empty, writes immediately
+        // Writes the chunk if it is not empty
         // Otherwise does nothing
         asio::awaitable<void> write(std::string_view chunk);
 
+        // Sends everything written so far
+        asio::awaitable<void> flush();
+
         // Sends 0 sized chunk to end the stream
         asio::awaitable<void> end();
 
@@ -44,6 +69,13 @@ public:
     public:
         asio::awaitable<void> write(std::string_view data);
 
+        // Writes the next `size` bytes of `file`. Large files are sent by the kernel straight to
+        // a socket after the held back data. Other writers get the file read and written in pieces
+        asio::awaitable<void> write_file(asio::stream_file& file, std::size_t size);
+
+        // Sends everything written so far
+        asio::awaitable<void> flush();
+
     private:
         friend class Response;
         Response& m_parent;
@@ -84,16 +116,28 @@ private:
     };
 
     void generate_head();
-    asio::awaitable<void> write_to_writer(std::vector<asio::const_buffer> buffers);
+    asio::awaitable<void> write_to_writer(WriteBuffers buffers);
+    asio::awaitable<void> flush_writer();
+    // Completes without writing, for the calls that have nothing to send
+    static asio::awaitable<void> no_write();
+
+    // Smaller files are copied into the output buffer, so they go out in one write with the head
+    static constexpr std::size_t MIN_SEND_FILE_SIZE = 16 * 1024;
 
 private:
     void* m_writer_ptr;
     WriteFn m_write_fn;
+    // Only set for a FlushableWriter
+    FlushFn m_flush_fn = nullptr;
+    // Only set for a FileWriter
+    SendFileFn m_send_file_fn = nullptr;
 
     std::string m_body;
     bool m_head;
     State m_state;
 
     std::string m_head_buffer;
+    // Size line of the chunk being written, "{:X}\r\n"
+    std::array<char, 2 * sizeof(std::size_t) + 2> m_chunk_size;
 };
 }
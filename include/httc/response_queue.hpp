@@ -0,0 +1,139 @@
+#pragma once
+
+#include <asio/any_io_executor.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/buffer.hpp>
+#include <asio/steady_timer.hpp>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "httc/io.hpp"
+
+namespace httc {
+
+// Output of the handler of one request, held until the responses before it are written
+struct ResponseSlot {
+    std::string output;
+    bool done = false;
+    // Close the connection once the output is written
+    bool close = false;
+};
+
+// Puts the responses of the requests of one connection that are handled at once back in request
+// order. Handlers write into their slot, and write_all() writes the slots in order as their output
+// comes in, so the oldest request can stream its response while later ones are held back.
+// Everything runs on the connection's executor, so no locking is needed.
+class ResponseQueue : public std::enable_shared_from_this<ResponseQueue> {
+public:
+    // A handler that has more than `max_slot_output` bytes held back in its slot waits until
+    // write_all() takes them
+    explicit ResponseQueue(
+        asio::any_io_executor executor,
+        std::size_t max_slot_output = ServerConfig{}.output_buffer_size
+    );
+
+    // Writes into one slot, waking up write_all(). Waits while the slot holds too much output
+    class SlotWriter {
+    public:
+        asio::awaitable<void> write(WriteBuffers buffers);
+
+    private:
+        friend class ResponseQueue;
+        SlotWriter(std::shared_ptr<ResponseQueue> queue, std::shared_ptr<ResponseSlot> slot)
+        : m_queue(std::move(queue)), m_slot(std::move(slot)) {
+        }
+
+        std::shared_ptr<ResponseQueue> m_queue;
+        std::shared_ptr<ResponseSlot> m_slot;
+    };
+
+    // Adds the slot of the next request
+    std::shared_ptr<ResponseSlot> push();
+
+    // Returns a writer into `slot`, which keeps the queue and the slot alive
+    SlotWriter writer(std::shared_ptr<ResponseSlot> slot);
+
+    // Number of slots that were not completely written yet
+    std::size_t size() const {
+        return m_slots.size();
+    }
+
+    // Wakes up everything waiting in wait()
+    void notify();
+
+    // Waits until notify() is called, which happens when a slot gets output, completes or is
+    // written
+    asio::awaitable<void> wait();
+
+    // No more slots will be pushed, so write_all() returns once all of them are written
+    void close();
+
+    // Writes the output of the slots in request order as it comes in. The output of completed
+    // slots is gathered into one write. Returns false if a slot asked to close the connection,
+    // without writing the slots after it
+    template<Writer W>
+    asio::awaitable<bool> write_all(W& writer);
+
+private:
+    std::deque<std::shared_ptr<ResponseSlot>> m_slots;
+    // Never expires, notify() cancels the waits on it
+    asio::steady_timer m_changed;
+    std::size_t m_max_slot_output;
+    bool m_closed = false;
+    // write_all() returned or failed, so output is no longer taken from the slots
+    bool m_stopped = false;
+};
+
+template<Writer W>
+asio::awaitable<bool> ResponseQueue::write_all(W& writer) {
+    // Handlers waiting for room in their slot must not wait forever once nothing is written
+    struct StopGuard {
+        ResponseQueue& queue;
+        ~StopGuard() {
+            queue.m_stopped = true;
+            queue.notify();
+        }
+    } stop_guard{ *this };
+
+    while (true) {
+        if (m_slots.empty() && m_closed) {
+            co_return true;
+        }
+
+        // Take the output of every completed slot at the front, and what the first incomplete
+        // one produced so far. Its handler keeps appending to a new string during the write
+        std::string output;
+        bool close = false;
+        bool written = false;
+        while (!m_slots.empty() && !close) {
+            auto& slot = *m_slots.front();
+            output.append(slot.output);
+            slot.output.clear();
+            if (!slot.done) {
+                break;
+            }
+            close = slot.close;
+            m_slots.pop_front();
+            written = true;
+        }
+
+        if (!output.empty()) {
+            // Handlers waiting for room can fill their slot again during the write
+            notify();
+            co_await writer.write({ asio::buffer(output) });
+        }
+        if (close) {
+            co_return false;
+        }
+        if (written) {
+            // Room in the window for another request
+            notify();
+        }
+        if (output.empty() && !written) {
+            co_await wait();
+        }
+    }
+}
+
+}
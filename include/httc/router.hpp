@@ -1,14 +1,24 @@
 #pragma once
 
+#include <array>
 #include <asio/awaitable.hpp>
 #include <concepts>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
+#include "httc/method.hpp"
 #include "httc/request.hpp"
 #include "httc/response.hpp"
+#include "httc/small_vector.hpp"
+#include "httc/unique_function.hpp"
 #include "httc/uri.hpp"
 
 namespace httc {
@@ -20,55 +30,193 @@ concept IsHandler = requires(T t, const Request& req, Response& res) {
 
 template<typename T>
 concept HasAllowedMethods = requires(T t) {
-    { t.getAllowedMethods() } -> std::convertible_to<std::vector<std::string>>;
+    { t.getAllowedMethods() } -> std::convertible_to<MethodSet>;
 } && IsHandler<T>;
 
-using HandlerFn = std::function<asio::awaitable<void>(const Request& req, Response& res)>;
-using MiddlewareFn =
-    std::function<asio::awaitable<void>(Request& req, Response& res, HandlerFn next)>;
+// Handlers and middleware are move-only, and stored inline when small. The router calls them in
+// place, so they are never copied after registration
+using HandlerFn = UniqueFunction<asio::awaitable<void>(const Request& req, Response& res)>;
+
+class Next;
+using MiddlewareFn = UniqueFunction<asio::awaitable<void>(Request& req, Response& res, Next next)>;
+
+// Continues the middleware chain of a request: runs the next middleware, or the route handler
+// after the last one. It points into the router and the request being handled, so it is cheap to
+// copy, and calling it allocates nothing besides the frame of the coroutine it runs
+class Next {
+public:
+    // Continues with the request being handled, which is also what `req` and `res` refer to
+    asio::awaitable<void> operator()(const Request& req, Response& res) const;
+
+private:
+    Next(
+        std::span<const MiddlewareFn> middleware, const HandlerFn& handler, Request& req,
+        Response& res
+    )
+    : m_middleware(middleware), m_handler(&handler), m_req(&req), m_res(&res) {
+    }
+
+    // The middleware left to run
+    std::span<const MiddlewareFn> m_middleware;
+    const HandlerFn* m_handler;
+    Request* m_req;
+    Response* m_res;
+
+    friend class Router;
+};
 
 template<IsHandler T>
 HandlerFn make_handler(T&& handler) {
-    return std::forward<T>(handler);
+    // A wrapper that owns a HandlerFn, like MethodWrapper, hands it over instead of being wrapped
+    // in another one
+    if constexpr (!std::is_lvalue_reference_v<T> && requires {
+                      { std::move(handler).into_handler() } -> std::same_as<HandlerFn>;
+                  }) {
+        return std::move(handler).into_handler();
+    } else {
+        return HandlerFn(std::forward<T>(handler));
+    }
 }
 
-class Router {
+struct RouteOptions {
+    // The handler runs as soon as the headers are parsed and reads the body through
+    // Request::body_reader, instead of getting it buffered in Request::body
+    bool stream_body = false;
+};
+
+// The route a router found for a request, to be handled by the same router
+struct RouteMatch {
+    // What the router matched, only meaningful to it: the route of the path, null if none
+    // matches, and its handler for the method, null for the default OPTIONS handler
+    const void* route = nullptr;
+    const void* handler = nullptr;
+    // A HEAD request handled by the GET handler
+    bool head_as_get = false;
+    bool method_not_allowed = false;
+    // The handler reads the body through Request::body_reader
+    bool stream_body = false;
+    // Request path segments matched by the :params of the route
+    SmallVector<std::uint32_t, 8> params;
+    // First request path segment matched by the * wildcard of the route
+    std::optional<std::size_t> wildcard;
+};
+
+// Dispatches requests to their handlers. bind_and_listen takes any router through this interface.
+// The server finds the route as soon as the head of a request is parsed, to know how to read its
+// body, and hands it back to handle()
+class RouterBase {
+public:
+    virtual ~RouterBase() = default;
+
+    virtual RouteMatch find_route(const Request& req) const = 0;
+
+    // Handles a request with the route find_route() returned for it
+    virtual asio::awaitable<void>
+        handle(const RouteMatch& route, Request& req, Response& res) const = 0;
+
+    asio::awaitable<void> handle(Request& req, Response& res) const;
+
+    // Returns true if the handler for this request reads its body through Request::body_reader
+    bool streams_body(const Request& req) const {
+        return find_route(req).stream_body;
+    }
+};
+
+// Value of the Allow header for the default OPTIONS handler of a route with these methods, and
+// these methods that are not standard
+std::string allow_header(MethodSet methods, std::span<const std::string_view> custom = {});
+
+class Router : public RouterBase {
 public:
     template<IsHandler T>
-    Router& route(std::string_view path, T&& handler) {
-        add_route(make_handler(std::forward<T>(handler)), path, std::nullopt);
+    Router& route(std::string_view path, T&& handler, RouteOptions options = {}) {
+        add_route(make_handler(std::forward<T>(handler)), path, std::nullopt, options);
         return *this;
     }
     template<HasAllowedMethods T>
-    Router& route(std::string_view path, T&& handler) {
-        auto methods = handler.getAllowedMethods();
-        add_route(make_handler(std::forward<T>(handler)), path, methods);
+    Router& route(std::string_view path, T&& handler, RouteOptions options = {}) {
+        MethodSet methods = handler.getAllowedMethods();
+        // Copied before the handler is moved, since they may point into it
+        std::vector<std::string> custom;
+        if constexpr (requires { handler.getCustomMethods(); }) {
+            for (std::string_view token : handler.getCustomMethods()) {
+                custom.emplace_back(token);
+            }
+        }
+        add_route(
+            make_handler(std::forward<T>(handler)), path, methods, options, std::move(custom)
+        );
         return *this;
     }
 
     Router& wrap(MiddlewareFn middleware);
 
-    asio::awaitable<void> handle(Request& req, Response& res) const;
+    RouteMatch find_route(const Request& req) const override;
+
+    using RouterBase::handle;
+    asio::awaitable<void>
+        handle(const RouteMatch& route, Request& req, Response& res) const override;
 
 private:
+    struct RouteHandler {
+        HandlerFn fn;
+        RouteOptions options;
+    };
+
     struct HandlerPath {
         HandlerPath(URI p) : path(p) {
         }
 
         URI path;
-        std::unordered_map<std::string, HandlerFn> method_handlers;
-        std::optional<HandlerFn> global_handler;
+        // A handler can be registered for several methods, so they are owned here and the
+        // methods point to them
+        std::vector<std::unique_ptr<RouteHandler>> handlers;
+        // Indexed by Method::Id, set for the methods in `methods`
+        std::array<const RouteHandler*, Method::COUNT> method_handlers{};
+        MethodSet methods;
+        // Methods that are not standard, by their token
+        std::vector<std::pair<std::string, const RouteHandler*>> custom_handlers;
+        const RouteHandler* global_handler = nullptr;
     };
 
+    // Hashes the static segments of the route tree, which are looked up by string_view
+    struct SegmentHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view segment) const {
+            return std::hash<std::string_view>{}(segment);
+        }
+    };
+
+    // A node of the route tree over path segments. A static child matches the segments of its
+    // label, so chains of static segments take one node. A node has at most one :param child and
+    // one * wildcard child
+    struct Node {
+        std::vector<std::string> label;
+        // Static children, by the first segment of their label
+        std::unordered_map<std::string, std::unique_ptr<Node>, SegmentHash, std::equal_to<>>
+            children;
+        std::unique_ptr<Node> param;
+        std::unique_ptr<Node> wildcard;
+        // Set if a route ends at this node
+        std::unique_ptr<HandlerPath> route;
+    };
+
+    struct Search;
+
     void add_route(
-        HandlerFn f, std::string_view path, std::optional<std::vector<std::string>> methods
+        HandlerFn f, std::string_view path, std::optional<MethodSet> methods, RouteOptions options,
+        std::vector<std::string> custom_methods = {}
     );
+    static void
+        add_method_handlers(HandlerPath& path, MethodSet methods, const RouteHandler* handler);
+    // Returns the route for this path, adding the nodes it needs
+    HandlerPath& insert_route(const URI& uri);
     void default_options_handler(const HandlerPath* handler, Response& res) const;
     asio::awaitable<void>
-        run_handler(HandlerFn f, const URI& handler_path, Request& req, Response& res) const;
+        run_handler(const HandlerFn& f, const RouteMatch& route, Request& req, Response& res) const;
 
 private:
-    std::vector<HandlerPath> m_handlers;
+    Node m_root;
     std::vector<MiddlewareFn> m_middleware;
 };
 
@@ -81,24 +229,62 @@ struct StringLiteral {
     char value[N];
 };
 
+// The methods a route is restricted to: the standard ones as a MethodSet, and the others by
+// their token
+template<StringLiteral... Methods>
+struct RouteMethods {
+    static constexpr std::array<std::string_view, sizeof...(Methods)> TOKENS = {
+        std::string_view(Methods.value)...
+    };
+
+    static constexpr MethodSet STANDARD = [] {
+        MethodSet set;
+        for (auto token : TOKENS) {
+            if (auto id = Method::find(token)) {
+                set.insert(*id);
+            }
+        }
+        return set;
+    }();
+
+    static constexpr std::size_t CUSTOM_COUNT =
+        (!Method::find(Methods.value).has_value() + ... + 0);
+    static constexpr std::array<std::string_view, CUSTOM_COUNT> CUSTOM = [] {
+        std::array<std::string_view, CUSTOM_COUNT> custom{};
+        std::size_t i = 0;
+        for (auto token : TOKENS) {
+            if (!Method::find(token).has_value()) {
+                custom[i++] = token;
+            }
+        }
+        return custom;
+    }();
+};
+
 template<StringLiteral... Methods>
 class MethodWrapper {
 public:
     template<IsHandler T>
     MethodWrapper(T&& f) : m_handler(make_handler(std::forward<T>(f))) {
-        m_methods = { std::string(Methods.value)... };
     }
 
-    asio::awaitable<void> operator()(const Request& req, Response& res) {
-        co_return co_await m_handler(req, res);
+    asio::awaitable<void> operator()(const Request& req, Response& res) const {
+        return m_handler(req, res);
+    }
+
+    MethodSet getAllowedMethods() const {
+        return RouteMethods<Methods...>::STANDARD;
+    }
+    // The methods that are not standard, such as PROPFIND
+    std::span<const std::string_view> getCustomMethods() const {
+        return RouteMethods<Methods...>::CUSTOM;
     }
 
-    std::vector<std::string> getAllowedMethods() const {
-        return m_methods;
+    HandlerFn into_handler() && {
+        return std::move(m_handler);
     }
 
 private:
-    std::vector<std::string> m_methods;
     HandlerFn m_handler;
 };
 
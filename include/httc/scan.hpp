@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace httc {
+
+// Returns the offset of the first "\r\n" in data at or after `from`,
+// or std::string_view::npos if there is none.
+// Scans 16 (SSE2) or 32 (AVX2) bytes per step when available.
+std::size_t find_crlf(std::string_view data, std::size_t from = 0);
+
+// Scans a block of field lines terminated by an empty line (a header or trailer section).
+// The offset of every CRLF found at or after `from` is appended to `line_ends`, in order.
+// Returns the offset just past the CRLF of the empty line, or std::string_view::npos if the
+// block is not complete yet.
+std::size_t
+    scan_header_lines(std::string_view data, std::size_t from, std::vector<std::size_t>& line_ends);
+
+}
@@ -3,14 +3,55 @@
 #include <asio.hpp>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "httc/router.hpp"
 #include "httc/server_config.hpp"
 
 namespace httc {
 
 void bind_and_listen(
-    std::string_view addr, unsigned int port, std::shared_ptr<Router> router,
+    std::string_view addr, unsigned int port, std::shared_ptr<RouterBase> router,
     asio::io_context& io_ctx, const ServerConfig& config = {}
 );
 
+// Serves one port from several threads. Every worker thread runs its own io_context with its own
+// SO_REUSEPORT acceptor, so the kernel spreads the connections over the threads and a connection
+// stays on the thread that accepted it. Handlers of different connections run in parallel, so the
+// router and its handlers must be safe to call from several threads at once
+class Server {
+public:
+    // Binds the acceptors, throwing if the address cannot be bound. Port 0 picks a free port,
+    // shared by all the workers
+    Server(
+        std::string_view addr, unsigned int port, std::shared_ptr<RouterBase> router,
+        const ServerConfig& config = {}
+    );
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // Runs the workers until stop() is called, blocking the calling thread
+    void run();
+
+    // Makes run() return. Can be called from any thread
+    void stop();
+
+    // Number of worker threads
+    std::size_t threads() const {
+        return m_io_contexts.size();
+    }
+
+    unsigned short port() const {
+        return m_port;
+    }
+
+private:
+    std::shared_ptr<RouterBase> m_router;
+    ServerConfig m_config;
+    unsigned short m_port;
+    // One per worker, each run by its own thread
+    std::vector<std::unique_ptr<asio::io_context>> m_io_contexts;
+};
+
 }
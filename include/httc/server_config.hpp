@@ -1,12 +1,34 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 
 namespace httc {
 struct ServerConfig {
     std::size_t max_header_size = 16 * 1024;
+    // Header fields allowed in a request, and trailer fields after a chunked body. Bounds the
+    // work of parsing a header block made of many tiny fields
+    std::size_t max_header_count = 100;
     std::size_t max_body_size = 16 * 1024 * 1024;
+    // Fixed size of the per-connection input buffer. Raised to max_header_size if smaller.
+    // Bodies that do not fit are read into their own allocation
+    std::size_t input_buffer_size = 16 * 1024;
+    // Output held back per connection before it is written. Small writes of streamed responses,
+    // and the responses to pipelined requests, are gathered up to this size. Held back output is
+    // also written when the connection waits for the next request, when the handler waits on
+    // anything else, or when a stream is flushed
+    std::size_t output_buffer_size = 64 * 1024;
     std::chrono::seconds request_timeout_seconds = std::chrono::seconds(30);
+    // Handlers that may run at once for the pipelined requests of one connection. Above 1, the
+    // server keeps parsing while handlers run, holds completed responses back and writes them in
+    // request order. Requests to routes that stream their body are still handled one at a time
+    std::size_t pipeline_window = 1;
+    // Worker threads of a Server, each with its own io_context and acceptor. 0 uses one per
+    // hardware thread
+    std::size_t threads = 0;
+    // Pins worker i of a Server to the i-th CPU the process may run on, modulo their count. Only
+    // on Linux
+    bool pin_threads = false;
 
     constexpr ServerConfig() = default;
 };
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace httc {
+
+// A vector that keeps up to N elements inline and moves them to the heap beyond that.
+// Limited to trivially destructible types, so elements are never destroyed one by one.
+template<typename T, std::size_t N>
+class SmallVector {
+    static_assert(std::is_trivially_destructible_v<T>);
+    static_assert(N > 0);
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() = default;
+
+    SmallVector(const SmallVector& other) {
+        append_from(other);
+    }
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            clear();
+            append_from(other);
+        }
+        return *this;
+    }
+
+    SmallVector(SmallVector&& other) noexcept {
+        take_from(other);
+    }
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            m_heap.reset();
+            m_size = 0;
+            m_capacity = N;
+            take_from(other);
+        }
+        return *this;
+    }
+
+    T* data() {
+        return m_heap ? reinterpret_cast<T*>(m_heap.get()) : inline_data();
+    }
+    const T* data() const {
+        return m_heap ? reinterpret_cast<const T*>(m_heap.get()) : inline_data();
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+    bool empty() const {
+        return m_size == 0;
+    }
+    std::size_t capacity() const {
+        return m_capacity;
+    }
+
+    T& operator[](std::size_t i) {
+        return data()[i];
+    }
+    const T& operator[](std::size_t i) const {
+        return data()[i];
+    }
+    T& back() {
+        return data()[m_size - 1];
+    }
+    const T& back() const {
+        return data()[m_size - 1];
+    }
+
+    iterator begin() {
+        return data();
+    }
+    iterator end() {
+        return data() + m_size;
+    }
+    const_iterator begin() const {
+        return data();
+    }
+    const_iterator end() const {
+        return data() + m_size;
+    }
+
+    void reserve(std::size_t capacity) {
+        if (capacity <= m_capacity) {
+            return;
+        }
+
+        auto heap = std::make_unique_for_overwrite<std::byte[]>(capacity * sizeof(T));
+        auto storage = reinterpret_cast<T*>(heap.get());
+        std::uninitialized_move(begin(), end(), storage);
+        m_heap.reset(heap.release());
+        m_capacity = capacity;
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (m_size == m_capacity) {
+            reserve(m_capacity * 2);
+        }
+        auto slot = ::new (static_cast<void*>(data() + m_size)) T(std::forward<Args>(args)...);
+        m_size++;
+        return *slot;
+    }
+
+    void push_back(const T& value) {
+        emplace_back(value);
+    }
+
+    // Drops the elements past `size`
+    void truncate(std::size_t size) {
+        m_size = std::min(m_size, size);
+    }
+
+    // Keeps the heap storage, if any
+    void clear() {
+        m_size = 0;
+    }
+
+private:
+    T* inline_data() {
+        return std::launder(reinterpret_cast<T*>(m_inline));
+    }
+    const T* inline_data() const {
+        return std::launder(reinterpret_cast<const T*>(m_inline));
+    }
+
+    void append_from(const SmallVector& other) {
+        reserve(other.m_size);
+        std::uninitialized_copy(other.begin(), other.end(), data());
+        m_size = other.m_size;
+    }
+
+    // Steals the heap storage of `other`, or copies its inline elements
+    void take_from(SmallVector& other) {
+        if (other.m_heap) {
+            m_heap = std::move(other.m_heap);
+            m_capacity = other.m_capacity;
+        } else {
+            std::uninitialized_move(other.begin(), other.end(), inline_data());
+        }
+        m_size = other.m_size;
+
+        other.m_size = 0;
+        other.m_capacity = N;
+    }
+
+private:
+    alignas(T) std::byte m_inline[N * sizeof(T)];
+    // Replaces the inline storage once it is full
+    std::unique_ptr<std::byte[]> m_heap;
+    std::size_t m_size = 0;
+    std::size_t m_capacity = N;
+};
+
+}
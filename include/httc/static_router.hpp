@@ -0,0 +1,452 @@
+#pragma once
+
+#include <array>
+#include <asio/awaitable.hpp>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include "httc/method.hpp"
+#include "httc/request.hpp"
+#include "httc/response.hpp"
+#include "httc/router.hpp"
+#include "httc/small_vector.hpp"
+#include "httc/status.hpp"
+#include "httc/uri.hpp"
+
+namespace httc {
+
+// A segment of a route pattern known at compile time
+struct RouteSegment {
+    enum Kind : std::uint8_t {
+        STATIC,
+        PARAM,
+        WILDCARD,
+    };
+
+    Kind kind;
+    std::string_view text;
+};
+
+// The segments of a route pattern, split like URI::parse splits a path. N is the size of the
+// pattern, which bounds the number of segments
+template<std::size_t N>
+struct RoutePattern {
+    constexpr RoutePattern(std::string_view path) {
+        if (path.empty() || path[0] != '/' || path.find_first_of("?%") != std::string_view::npos) {
+            return;
+        }
+
+        // Empty segments are dropped, except the last one
+        std::size_t start = 1;
+        while (true) {
+            auto end = path.find('/', start);
+            if (end == std::string_view::npos) {
+                add(path.substr(start));
+                break;
+            }
+            if (end > start) {
+                add(path.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+
+        // A wildcard can only be the last segment
+        for (std::size_t i = 0; i + 1 < size; i++) {
+            if (segments[i].kind == RouteSegment::WILDCARD) {
+                return;
+            }
+        }
+        valid = true;
+    }
+
+    constexpr std::span<const RouteSegment> view() const {
+        return { segments.data(), size };
+    }
+
+    std::array<RouteSegment, N> segments{};
+    std::size_t size = 0;
+    // False if the pattern is not a path, or is percent-encoded
+    bool valid = false;
+
+private:
+    constexpr void add(std::string_view segment) {
+        if (segment == "*") {
+            segments[size++] = { RouteSegment::WILDCARD, segment };
+        } else if (segment.starts_with(':')) {
+            segments[size++] = { RouteSegment::PARAM, segment };
+        } else {
+            segments[size++] = { RouteSegment::STATIC, segment };
+        }
+    }
+};
+
+// A route of a StaticRouter. Handler is default constructed by the router unless the router is
+// given an instance. Without Methods the route handles every method
+template<StringLiteral Path, typename Handler, StringLiteral... Methods>
+struct Route {
+    static_assert(IsHandler<const Handler>, "Route handlers must be callable when const");
+
+    using HandlerType = Handler;
+
+    static constexpr std::string_view PATH = { Path.value, sizeof(Path.value) - 1 };
+    static constexpr RoutePattern<sizeof(Path.value)> PATTERN = PATH;
+    static_assert(PATTERN.valid, "Invalid route path");
+
+    static constexpr bool ALL_METHODS = sizeof...(Methods) == 0;
+    static constexpr MethodSet METHODS = RouteMethods<Methods...>::STANDARD;
+    // Methods that are not standard, matched by their token
+    static constexpr auto CUSTOM_METHODS = RouteMethods<Methods...>::CUSTOM;
+    static constexpr RouteOptions ROUTE_OPTIONS = {};
+};
+
+// A route whose handler reads its body through Request::body_reader
+template<StringLiteral Path, typename Handler, StringLiteral... Methods>
+struct StreamingRoute : Route<Path, Handler, Methods...> {
+    static constexpr RouteOptions ROUTE_OPTIONS = { .stream_body = true };
+};
+
+// The route tree of a StaticRouter, built at compile time. It has one node per segment, and
+// static children are kept as a list, since there are few of them. Routes of methods that are not
+// standard are kept in one list for the whole tree, since they are rare
+template<std::size_t CAPACITY, std::size_t CUSTOM_CAPACITY>
+struct StaticRouteTree {
+    static constexpr std::size_t NONE = SIZE_MAX;
+
+    struct CustomRoute {
+        std::size_t node = NONE;
+        std::string_view token;
+        std::size_t route = NONE;
+    };
+
+    struct Node {
+        // Segment matched by a static node
+        std::string_view segment;
+        // First static child, and the next static child of the parent
+        std::size_t children = NONE;
+        std::size_t next = NONE;
+        std::size_t param = NONE;
+        std::size_t wildcard = NONE;
+
+        // Indexed by Method::Id, the route handling each method in `methods`
+        std::array<std::size_t, Method::COUNT> method_routes{};
+        MethodSet methods;
+        std::size_t global_route = NONE;
+        // Set if a route of a method that is not standard ends here
+        bool custom_routes = false;
+
+        constexpr bool has_route() const {
+            return !methods.empty() || global_route != NONE || custom_routes;
+        }
+    };
+
+    // Adds a route, and marks the tree as colliding if another route already handles one of its
+    // methods. Routes that only differ by the names of their params collide
+    constexpr void insert(
+        std::size_t route, std::span<const RouteSegment> segments, bool all_methods,
+        MethodSet methods, std::span<const std::string_view> custom_methods
+    ) {
+        std::size_t node = 0;
+        for (const auto& segment : segments) {
+            if (segment.kind == RouteSegment::WILDCARD) {
+                node = child(nodes[node].wildcard);
+            } else if (segment.kind == RouteSegment::PARAM) {
+                node = child(nodes[node].param);
+            } else {
+                node = static_child(node, segment.text);
+            }
+        }
+
+        auto& target = nodes[node];
+        if (all_methods) {
+            collision = collision || target.global_route != NONE;
+            target.global_route = route;
+            return;
+        }
+        collision = collision || target.methods.intersects(methods);
+        for (std::size_t i = 0; i < Method::COUNT; i++) {
+            auto method = static_cast<Method::Id>(i);
+            if (methods.contains(method)) {
+                target.method_routes[i] = route;
+                target.methods.insert(method);
+            }
+        }
+        for (auto token : custom_methods) {
+            collision = collision || find_custom(node, token) != NONE;
+            custom[custom_size++] = { node, token, route };
+            target.custom_routes = true;
+        }
+    }
+
+    // Returns the route of a node for a method that is not standard, or NONE
+    constexpr std::size_t find_custom(std::size_t node, std::string_view token) const {
+        for (std::size_t i = 0; i < custom_size; i++) {
+            if (custom[i].node == node && custom[i].token == token) {
+                return custom[i].route;
+            }
+        }
+        return NONE;
+    }
+
+    std::array<Node, CAPACITY> nodes{};
+    std::size_t size = 1;
+    std::array<CustomRoute, CUSTOM_CAPACITY> custom{};
+    std::size_t custom_size = 0;
+    bool collision = false;
+
+private:
+    constexpr std::size_t child(std::size_t& link) {
+        if (link == NONE) {
+            link = size++;
+        }
+        return link;
+    }
+
+    constexpr std::size_t static_child(std::size_t node, std::string_view segment) {
+        auto* link = &nodes[node].children;
+        while (*link != NONE) {
+            if (nodes[*link].segment == segment) {
+                return *link;
+            }
+            link = &nodes[*link].next;
+        }
+        auto created = child(*link);
+        nodes[created].segment = segment;
+        return created;
+    }
+};
+
+// A router for routes fixed at compile time:
+//
+//     httc::StaticRouter<
+//         httc::Route<"/users/:id", GetUser, "GET">,
+//         httc::Route<"/health", Health>>
+//
+// The route tree is built at compile time, and route collisions are compile errors instead of
+// URICollision exceptions. Handlers are called directly, without a HandlerFn in between.
+// Precedence is the same as for Router: full matches, then param matches, then wildcard matches.
+// StaticRouter has no middleware
+template<typename... Routes>
+class StaticRouter : public RouterBase {
+    static_assert(sizeof...(Routes) > 0, "A StaticRouter needs at least one route");
+
+public:
+    StaticRouter()
+        requires(std::default_initializable<typename Routes::HandlerType> && ...)
+    = default;
+
+    explicit StaticRouter(typename Routes::HandlerType... handlers)
+    : m_handlers(std::move(handlers)...) {
+    }
+
+    RouteMatch find_route(const Request& req) const override {
+        Search search{
+            .paths = req.uri.paths(), .method = req.method.id(), .token = req.method.name()
+        };
+        search.walk(0, 0);
+
+        bool method_not_allowed = false;
+        for (auto& match : search.matches) {
+            if (!match.has_value()) {
+                continue;
+            }
+            if (!match->method_not_allowed) {
+                auto options = static_cast<const RouteOptions*>(match->handler);
+                match->stream_body = options != nullptr && options->stream_body;
+                return std::move(*match);
+            }
+            method_not_allowed = true;
+        }
+
+        return { .method_not_allowed = method_not_allowed };
+    }
+
+    using RouterBase::handle;
+    asio::awaitable<void>
+        handle(const RouteMatch& route, Request& req, Response& res) const override {
+        if (route.route == nullptr) {
+            if (route.method_not_allowed) {
+                res.status = StatusCode::METHOD_NOT_ALLOWED;
+            } else {
+                res.status = StatusCode::NOT_FOUND;
+            }
+            co_return;
+        }
+
+        if (route.handler == nullptr) {
+            // Default OPTIONS handler
+            auto node = static_cast<const typename Tree::Node*>(route.route);
+            auto index = static_cast<std::size_t>(node - TREE.nodes.data());
+            SmallVector<std::string_view, 4> custom;
+            for (std::size_t i = 0; i < TREE.custom_size; i++) {
+                if (TREE.custom[i].node == index) {
+                    custom.push_back(TREE.custom[i].token);
+                }
+            }
+            res.status = StatusCode::OK;
+            res.headers.set(
+                "Allow", allow_header(node->methods, { custom.data(), custom.size() })
+            );
+            co_return;
+        }
+
+        // The handler is the options of the route, which give its index
+        auto index = static_cast<std::size_t>(
+            static_cast<const RouteOptions*>(route.handler) - ROUTE_OPTIONS.data()
+        );
+        auto req_paths = req.uri.paths();
+        auto segments = SEGMENTS[index];
+        req.path_params.clear();
+        for (auto i : route.params) {
+            req.path_params.add(segments[i].text.substr(1), req_paths[i]);
+        }
+        req.wildcard_path = {};
+        if (route.wildcard.has_value()) {
+            req.wildcard_path = req.uri.path_from(*route.wildcard);
+        }
+
+        if (route.head_as_get) {
+            req.method = Method::GET;
+        }
+        co_await call(index, req, res);
+    }
+
+private:
+    static constexpr std::size_t ROUTE_COUNT = sizeof...(Routes);
+    // A node per segment, and the root
+    static constexpr std::size_t CAPACITY = (Routes::PATTERN.size + ... + 1);
+    static constexpr std::size_t CUSTOM_CAPACITY = (Routes::CUSTOM_METHODS.size() + ... + 0);
+
+    using Tree = StaticRouteTree<CAPACITY, CUSTOM_CAPACITY>;
+
+    static constexpr Tree TREE = [] {
+        Tree tree;
+        std::size_t route = 0;
+        (tree.insert(
+             route++, Routes::PATTERN.view(), Routes::ALL_METHODS, Routes::METHODS,
+             Routes::CUSTOM_METHODS
+         ),
+         ...);
+        return tree;
+    }();
+    static_assert(!TREE.collision, "Route collision");
+
+    static constexpr std::array<std::span<const RouteSegment>, ROUTE_COUNT> SEGMENTS = {
+        Routes::PATTERN.view()...
+    };
+    static constexpr std::array<RouteOptions, ROUTE_COUNT> ROUTE_OPTIONS = {
+        Routes::ROUTE_OPTIONS...
+    };
+
+    // Same walk as Router::Search, over the tree built at compile time. Matches point to their
+    // node in TREE, and to the options of their route in ROUTE_OPTIONS as the handler
+    struct Search {
+        enum Category {
+            FULL,
+            PARAM,
+            WILD,
+        };
+
+        URI::Paths paths;
+        Method::Id method;
+        std::string_view token;
+        SmallVector<std::uint32_t, 8> params;
+        std::optional<RouteMatch> matches[3];
+
+        bool select_handler(std::size_t index, RouteMatch& match) const {
+            const auto& node = TREE.nodes[index];
+            auto custom = method == Method::OTHER ? TREE.find_custom(index, token) : Tree::NONE;
+            if (node.methods.contains(method)) {
+                match.handler = &ROUTE_OPTIONS[node.method_routes[method]];
+            } else if (custom != Tree::NONE) {
+                match.handler = &ROUTE_OPTIONS[custom];
+            } else if (node.global_route != Tree::NONE) {
+                match.handler = &ROUTE_OPTIONS[node.global_route];
+            } else if (method == Method::HEAD && node.methods.contains(Method::GET)) {
+                match.handler = &ROUTE_OPTIONS[node.method_routes[Method::GET]];
+                match.head_as_get = true;
+            } else if (method != Method::OPTIONS) {
+                return false;
+            }
+            return true;
+        }
+
+        bool add(Category category, std::size_t node, std::optional<std::size_t> wildcard) {
+            if (matches[category].has_value()) {
+                return false;
+            }
+
+            RouteMatch match{ .route = &TREE.nodes[node] };
+            match.params = params;
+            match.wildcard = wildcard;
+            bool usable = select_handler(node, match);
+            if (!usable) {
+                match.method_not_allowed = true;
+            }
+            matches[category] = std::move(match);
+            return usable && category != WILD;
+        }
+
+        bool walk(std::size_t node, std::size_t i) {
+            const auto& current = TREE.nodes[node];
+            auto wildcard = current.wildcard;
+            bool wildcard_route = wildcard != Tree::NONE && TREE.nodes[wildcard].has_route();
+
+            if (i == paths.size()) {
+                if (current.has_route() && add(params.empty() ? FULL : PARAM, node, std::nullopt)) {
+                    return true;
+                }
+                if (wildcard_route) {
+                    add(WILD, wildcard, i);
+                }
+                return false;
+            }
+
+            auto segment = paths[i];
+            for (auto child = current.children; child != Tree::NONE;
+                 child = TREE.nodes[child].next) {
+                if (TREE.nodes[child].segment == segment) {
+                    if (walk(child, i + 1)) {
+                        return true;
+                    }
+                    break;
+                }
+            }
+
+            if (current.param != Tree::NONE && !segment.empty()) {
+                params.push_back(static_cast<std::uint32_t>(i));
+                if (walk(current.param, i + 1)) {
+                    return true;
+                }
+                params.truncate(params.size() - 1);
+            }
+
+            if (wildcard_route) {
+                add(WILD, wildcard, i);
+            }
+            return false;
+        }
+    };
+
+    // Calls the handler of a route, through a chain of comparisons the compiler can turn into a
+    // switch
+    template<std::size_t I = 0>
+    asio::awaitable<void> call(std::size_t route, const Request& req, Response& res) const {
+        if constexpr (I + 1 == ROUTE_COUNT) {
+            return std::get<I>(m_handlers)(req, res);
+        } else {
+            if (route == I) {
+                return std::get<I>(m_handlers)(req, res);
+            }
+            return call<I + 1>(route, req, res);
+        }
+    }
+
+    std::tuple<typename Routes::HandlerType...> m_handlers;
+};
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace httc {
+
+template<typename Signature, std::size_t INLINE_SIZE = 6 * sizeof(void*)>
+class UniqueFunction;
+
+// A move-only std::function. Callables of up to INLINE_SIZE bytes that can be moved without
+// throwing are stored inline, and larger ones on the heap. Like std::function, calling it through
+// a const reference calls the stored callable as non-const
+template<typename R, typename... Args, std::size_t INLINE_SIZE>
+class UniqueFunction<R(Args...), INLINE_SIZE> {
+public:
+    UniqueFunction() = default;
+    UniqueFunction(std::nullptr_t) {
+    }
+
+    template<typename F>
+        requires(!std::same_as<std::remove_cvref_t<F>, UniqueFunction>
+                 && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>)
+    UniqueFunction(F&& f) {
+        using T = std::decay_t<F>;
+        if constexpr (std::is_pointer_v<T> || std::is_member_pointer_v<T>) {
+            if (f == nullptr) {
+                return;
+            }
+        }
+
+        if constexpr (stored_inline<T>()) {
+            new (m_storage) T(std::forward<F>(f));
+        } else {
+            new (m_storage) T*(new T(std::forward<F>(f)));
+        }
+        m_ops = &OPS<T>;
+    }
+
+    UniqueFunction(UniqueFunction&& other) noexcept {
+        take_from(other);
+    }
+    UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take_from(other);
+        }
+        return *this;
+    }
+
+    UniqueFunction(const UniqueFunction&) = delete;
+    UniqueFunction& operator=(const UniqueFunction&) = delete;
+
+    ~UniqueFunction() {
+        reset();
+    }
+
+    explicit operator bool() const {
+        return m_ops != nullptr;
+    }
+
+    R operator()(Args... args) const {
+        return m_ops->invoke(m_storage, std::forward<Args>(args)...);
+    }
+
+private:
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        // Moves the callable from `src` to the empty `dst`, and destroys it in `src`
+        void (*relocate)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template<typename T>
+    static constexpr bool stored_inline() {
+        return sizeof(T) <= INLINE_SIZE && alignof(T) <= alignof(std::max_align_t)
+               && std::is_nothrow_move_constructible_v<T>;
+    }
+
+    template<typename T>
+    static T& target(void* storage) {
+        if constexpr (stored_inline<T>()) {
+            return *std::launder(static_cast<T*>(storage));
+        } else {
+            return **std::launder(static_cast<T**>(storage));
+        }
+    }
+
+    template<typename T>
+    static constexpr Ops OPS = {
+        .invoke = [](void* storage, Args&&... args) -> R {
+            return std::invoke_r<R>(target<T>(storage), std::forward<Args>(args)...);
+        },
+        .relocate =
+            [](void* dst, void* src) noexcept {
+                if constexpr (stored_inline<T>()) {
+                    new (dst) T(std::move(target<T>(src)));
+                    target<T>(src).~T();
+                } else {
+                    new (dst) T*(&target<T>(src));
+                }
+            },
+        .destroy =
+            [](void* storage) noexcept {
+                if constexpr (stored_inline<T>()) {
+                    target<T>(storage).~T();
+                } else {
+                    delete &target<T>(storage);
+                }
+            },
+    };
+
+    void take_from(UniqueFunction& other) noexcept {
+        if (other.m_ops != nullptr) {
+            other.m_ops->relocate(m_storage, other.m_storage);
+            m_ops = std::exchange(other.m_ops, nullptr);
+        }
+    }
+
+    void reset() noexcept {
+        if (m_ops != nullptr) {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) mutable unsigned char m_storage[INLINE_SIZE];
+    const Ops* m_ops = nullptr;
+};
+
+}
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <format>
+#include <iterator>
 #include <optional>
 #include <string>
-#include <vector>
+#include <string_view>
+#include <utility>
+#include "httc/small_vector.hpp"
 
 namespace httc {
 
@@ -15,30 +19,141 @@ enum class URIMatch {
     FULL_MATCH, // e.g., /path/exact matches /path/exact, better than anything else
 };
 
+// The URI is kept in one buffer, and path segments and query parameters are offsets into it.
+// Path segments are percent-decoded when parsed and packed at the start of the buffer, joined by
+// '/', so a run of segments is also one piece of the buffer. The query is decoded in place the
+// first time it is read, which is the only write through a const URI: query() and query_param()
+// must not be called on the same URI from several threads until the query was read once.
 class URI {
+    // A piece of m_buf
+    struct Slice {
+        std::uint32_t offset;
+        std::uint32_t size;
+    };
+    using QuerySlice = std::pair<Slice, Slice>;
+
+    static std::string_view resolve(const std::string& buf, Slice slice) {
+        return std::string_view(buf).substr(slice.offset, slice.size);
+    }
+    static std::pair<std::string_view, std::string_view>
+        resolve(const std::string& buf, const QuerySlice& slice) {
+        return { resolve(buf, slice.first), resolve(buf, slice.second) };
+    }
+
 public:
+    // Random access view over the path segments or the query parameters, valid as long as the URI
+    // is not modified
+    template<typename Piece>
+    class View {
+    public:
+        using value_type = decltype(resolve(std::declval<const std::string&>(), Piece{}));
+
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = View::value_type;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() = default;
+
+            value_type operator*() const {
+                return resolve(*m_buf, *m_piece);
+            }
+            Iterator& operator++() {
+                ++m_piece;
+                return *this;
+            }
+            Iterator operator++(int) {
+                auto it = *this;
+                ++m_piece;
+                return it;
+            }
+            bool operator==(const Iterator& other) const {
+                return m_piece == other.m_piece;
+            }
+
+        private:
+            Iterator(const std::string* buf, const Piece* piece) : m_buf(buf), m_piece(piece) {
+            }
+
+            const std::string* m_buf = nullptr;
+            const Piece* m_piece = nullptr;
+
+            friend class View;
+        };
+
+        std::size_t size() const {
+            return m_size;
+        }
+        bool empty() const {
+            return m_size == 0;
+        }
+        value_type operator[](std::size_t i) const {
+            return resolve(*m_buf, m_pieces[i]);
+        }
+        value_type back() const {
+            return resolve(*m_buf, m_pieces[m_size - 1]);
+        }
+
+        Iterator begin() const {
+            return Iterator(m_buf, m_pieces);
+        }
+        Iterator end() const {
+            return Iterator(m_buf, m_pieces + m_size);
+        }
+
+    private:
+        View(const std::string* buf, const Piece* pieces, std::size_t size)
+        : m_buf(buf), m_pieces(pieces), m_size(size) {
+        }
+
+        const std::string* m_buf;
+        const Piece* m_pieces;
+        std::size_t m_size;
+
+        friend class URI;
+    };
+
+    using Paths = View<Slice>;
+    using Query = View<QuerySlice>;
+
     URI() = delete;
 
-    [[nodiscard]] static std::optional<URI> parse(std::string_view url_decoded);
+    [[nodiscard]] static std::optional<URI> parse(std::string_view uri);
 
     [[nodiscard]] URIMatch match(const URI& other) const;
 
-    [[nodiscard]] const std::vector<std::string>& paths() const;
-    [[nodiscard]] const std::vector<std::pair<std::string, std::string>>& query() const;
+    [[nodiscard]] Paths paths() const;
+    // The decoded path from segment `first` to the end, with its segments joined by '/'
+    [[nodiscard]] std::string_view path_from(std::size_t first) const;
+    // The first call decodes the query in place, so it is not thread safe. Path views stay valid
+    [[nodiscard]] Query query() const;
+    // Decodes the query like query() on the first call
     [[nodiscard]] std::optional<std::string_view> query_param(std::string_view param) const;
 
     [[nodiscard]] std::string to_string() const;
     [[nodiscard]] std::string path() const;
 
 private:
-    URI(std::vector<std::string>&& paths, std::vector<std::pair<std::string, std::string>>&& query)
-    : m_paths(std::move(paths)), m_query(std::move(query)) {
+    explicit URI(std::string_view uri) : m_buf(uri) {
     }
 
+    // Splits and decodes the query the first time it is read
+    void parse_query() const;
+
 private:
-    std::vector<std::string> m_paths;
-    std::vector<std::pair<std::string, std::string>> m_query;
-    std::string m_buf;
+    static constexpr std::size_t INLINE_SEGMENTS = 8;
+    static constexpr std::size_t INLINE_QUERY = 4;
+
+    // The URI as received, with the decoded path written over its start and decoded query pieces
+    // written over their encoded form
+    mutable std::string m_buf;
+    SmallVector<Slice, INLINE_SEGMENTS> m_paths;
+
+    // Offset of the query after the '?', or m_buf.size() without one
+    std::uint32_t m_query_start = 0;
+    mutable bool m_query_parsed = false;
+    mutable SmallVector<QuerySlice, INLINE_QUERY> m_query;
 };
 
 }
@@ -47,13 +162,13 @@ template<>
 struct std::formatter<httc::URI> : std::formatter<std::string> {
     auto format(const httc::URI& uri, std::format_context& ctx) const {
         auto out = ctx.out();
-        for (const auto& path : uri.paths()) {
+        for (auto path : uri.paths()) {
             out = std::format_to(out, "/{}", path);
         }
         if (!uri.query().empty()) {
             out = std::format_to(out, "?");
             bool first = true;
-            for (const auto& [key, value] : uri.query()) {
+            for (auto [key, value] : uri.query()) {
                 if (!first) {
                     out = std::format_to(out, "&");
                 }
@@ -4,7 +4,9 @@
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "httc/method.hpp"
 #include "httc/request.hpp"
 #include "httc/response.hpp"
 
@@ -16,8 +18,8 @@ public:
 
     asio::awaitable<void> operator()(const Request& req, Response& res) const;
 
-    std::vector<std::string> getAllowedMethods() const {
-        return { "GET" };
+    MethodSet getAllowedMethods() const {
+        return { Method::GET };
     }
 
 private:
@@ -30,13 +32,13 @@ public:
 
     asio::awaitable<void> operator()(const Request& req, Response& res) const;
 
-    std::vector<std::string> getAllowedMethods() const {
-        return { "GET" };
+    MethodSet getAllowedMethods() const {
+        return { Method::GET };
     }
 
 private:
     std::string generate_listing_html(
-        const std::string& url_path, const struct DirectoryListing& listing
+        std::string_view url_path, const struct DirectoryListing& listing
     ) const;
     std::optional<std::filesystem::path> sanitize_path(std::string_view request_path) const;
 
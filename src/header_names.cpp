@@ -0,0 +1,241 @@
+#include "httc/header_names.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <random>
+
+namespace httc {
+
+namespace {
+
+// In the order of the Header enum
+constexpr std::array<std::string_view, HEADER_COUNT> NAMES = {
+    "Accept",
+    "Accept-Charset",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Accept-Ranges",
+    "Access-Control-Allow-Credentials",
+    "Access-Control-Allow-Headers",
+    "Access-Control-Allow-Methods",
+    "Access-Control-Allow-Origin",
+    "Access-Control-Expose-Headers",
+    "Access-Control-Max-Age",
+    "Access-Control-Request-Headers",
+    "Access-Control-Request-Method",
+    "Age",
+    "Allow",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Disposition",
+    "Content-Encoding",
+    "Content-Language",
+    "Content-Length",
+    "Content-Location",
+    "Content-Range",
+    "Content-Security-Policy",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Expect",
+    "Expires",
+    "Forwarded",
+    "From",
+    "Host",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Keep-Alive",
+    "Last-Modified",
+    "Link",
+    "Location",
+    "Max-Forwards",
+    "Origin",
+    "Pragma",
+    "Proxy-Authenticate",
+    "Proxy-Authorization",
+    "Range",
+    "Referer",
+    "Retry-After",
+    "Server",
+    "Set-Cookie",
+    "Strict-Transport-Security",
+    "TE",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "User-Agent",
+    "Vary",
+    "Via",
+    "WWW-Authenticate",
+    "X-Forwarded-For",
+    "X-Forwarded-Host",
+    "X-Forwarded-Proto",
+    "X-Requested-With",
+};
+
+constexpr std::size_t TABLE_BITS = 9;
+
+constexpr std::uint64_t ONES = 0x0101010101010101u;
+
+// Sets the lowercase bit of the bytes of `word` that are 'A'..'Z', all 8 at once. The low 7 bits
+// of each byte are offset so that the top bit tells whether they are above 'Z', and at or above
+// 'A', without carrying into the next byte
+constexpr std::uint64_t fold_upper(std::uint64_t word) {
+    auto low = word & (0x7F * ONES);
+    auto above_z = low + (0x7F - 'Z') * ONES;
+    auto from_a = low + (0x80 - 'A') * ONES;
+    auto upper = (from_a ^ above_z) & ~word & (0x80 * ONES);
+    return word | (upper >> 2);
+}
+
+// Bytes p[0..n) of a name with uppercase letters folded to lowercase, as a little endian word
+constexpr std::uint64_t load_folded(const char* p, std::size_t n) {
+    std::uint64_t word = 0;
+    if (std::is_constant_evaluated()) {
+        for (std::size_t i = 0; i < n; i++) {
+            word |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+    } else {
+        std::memcpy(&word, p, n);
+        if constexpr (std::endian::native == std::endian::big) {
+            word = std::byteswap(word);
+        }
+    }
+    return fold_upper(word);
+}
+
+// Length, first 8 and last 8 bytes of a name, which tell all the well-known names apart.
+// Shorter names are loaded whole
+constexpr std::uint64_t name_key(std::string_view name) {
+    auto n = std::min<std::size_t>(name.size(), 8);
+    auto first = load_folded(name.data(), n);
+    auto last = load_folded(name.data() + name.size() - n, n);
+    return first ^ std::rotl(last, 31) ^ name.size();
+}
+
+struct PerfectHash {
+    std::uint64_t multiplier;
+    // Header index + 1 for every slot, 0 if no name has it
+    std::array<std::uint8_t, std::size_t(1) << TABLE_BITS> slots;
+
+    constexpr std::size_t slot(std::uint64_t key) const {
+        return (key * multiplier) >> (64 - TABLE_BITS);
+    }
+};
+
+// Tries multipliers until every name gets its own slot
+constexpr PerfectHash make_perfect_hash() {
+    std::array<std::uint64_t, HEADER_COUNT> keys{};
+    for (std::size_t i = 0; i < NAMES.size(); i++) {
+        keys[i] = name_key(NAMES[i]);
+    }
+
+    for (std::uint64_t multiplier = 0x9E3779B97F4A7C15u;; multiplier += 2) {
+        PerfectHash ph{ multiplier, {} };
+        bool collision = false;
+        for (std::size_t i = 0; i < NAMES.size() && !collision; i++) {
+            auto& slot = ph.slots[ph.slot(keys[i])];
+            collision = slot != 0;
+            slot = static_cast<std::uint8_t>(i + 1);
+        }
+        if (!collision) {
+            return ph;
+        }
+    }
+}
+
+constexpr PerfectHash PERFECT_HASH = make_perfect_hash();
+
+// Folded 128 bit product
+std::uint64_t mix(std::uint64_t a, std::uint64_t b) {
+    auto product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+}
+
+// Key of hash_header_name, drawn once per process
+struct HashKey {
+    std::uint64_t k0;
+    std::uint64_t k1;
+};
+
+HashKey random_hash_key() {
+    std::random_device device;
+    auto draw = [&] {
+        return (std::uint64_t(device()) << 32) | device();
+    };
+    // Odd, so a word equal to the other half of the key can't zero the product
+    return { draw() | 1, draw() | 1 };
+}
+
+// Drawn on first use, so hashing from the initializer of another static is safe
+const HashKey& hash_key() {
+    static const HashKey key = random_hash_key();
+    return key;
+}
+
+constexpr bool is_alpha(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+}
+
+std::uint32_t hash_header_name(std::string_view name) {
+    const auto& key = hash_key();
+    std::uint64_t hash = key.k0 ^ name.size();
+
+    // 8 bytes per step, with the uppercase letters of the whole step folded at once, which hashes
+    // names case insensitively without a tolower per byte
+    std::size_t i = 0;
+    for (; i + 8 <= name.size(); i += 8) {
+        hash = mix(load_folded(name.data() + i, 8) ^ key.k1, hash);
+    }
+    if (i < name.size()) {
+        hash = mix(load_folded(name.data() + i, name.size() - i) ^ key.k1, hash);
+    }
+
+    hash = mix(hash, key.k0);
+    return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+bool header_names_equal(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < a.size(); i++) {
+        // Equal bytes, or the same letter in another case
+        auto diff = a[i] ^ b[i];
+        if (diff != 0 && (diff != 0x20 || !is_alpha(a[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view header_name(Header header) {
+    return NAMES[static_cast<std::size_t>(header)];
+}
+
+std::optional<Header> find_header(std::string_view name) {
+    if (name.empty()) {
+        return std::nullopt;
+    }
+
+    auto slot = PERFECT_HASH.slots[PERFECT_HASH.slot(name_key(name))];
+    if (slot == 0) {
+        return std::nullopt;
+    }
+
+    auto index = static_cast<std::size_t>(slot - 1);
+    if (!header_names_equal(name, NAMES[index])) {
+        return std::nullopt;
+    }
+    return static_cast<Header>(index);
+}
+
+}
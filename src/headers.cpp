@@ -1,17 +1,108 @@
 #include "httc/headers.hpp"
+#include <bit>
 #include <cstring>
 #include <stdexcept>
 #include "httc/validation.hpp"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace httc {
 
-Headers::Headers() : m_pool(std::make_unique<std::pmr::monotonic_buffer_resource>()) {
+namespace {
+
+#if defined(__AVX2__)
+constexpr std::size_t HASH_BLOCK = 8;
+
+// Bit i is set if hashes[i] == hash
+std::uint32_t hash_mask(const std::uint32_t* hashes, std::uint32_t hash) {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes));
+    auto eq = _mm256_cmpeq_epi32(block, _mm256_set1_epi32(static_cast<int>(hash)));
+    return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+}
+#elif defined(__SSE2__)
+constexpr std::size_t HASH_BLOCK = 4;
+
+// Bit i is set if hashes[i] == hash
+std::uint32_t hash_mask(const std::uint32_t* hashes, std::uint32_t hash) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hashes));
+    auto eq = _mm_cmpeq_epi32(block, _mm_set1_epi32(static_cast<int>(hash)));
+    return static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+}
+#endif
+
 }
+
+Headers::Headers() = default;
 Headers::Headers(Headers&&) noexcept = default;
 Headers& Headers::operator=(Headers&&) noexcept = default;
 Headers::~Headers() = default;
 
+std::size_t Headers::find(std::string_view name, std::uint32_t hash, std::size_t from) const {
+    const std::uint32_t* hashes = m_hashes.data();
+    const std::size_t n = m_hashes.size();
+    std::size_t i = from;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + HASH_BLOCK <= n; i += HASH_BLOCK) {
+        auto mask = hash_mask(hashes + i, hash);
+        while (mask != 0) {
+            std::size_t index = i + std::countr_zero(mask);
+            if (header_names_equal(m_entries[index].first, name)) {
+                return index;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Scalar tail, or the whole array without SIMD support
+    for (; i < n; i++) {
+        if (hashes[i] == hash && header_names_equal(m_entries[i].first, name)) {
+            return i;
+        }
+    }
+    return n;
+}
+
+std::size_t Headers::indexed_find(std::string_view name, std::uint32_t hash) const {
+    const std::size_t mask = m_index.size() - 1;
+    for (std::size_t i = index_slot(hash);; i = (i + 1) & mask) {
+        auto slot = m_index[i];
+        if (slot == 0) {
+            return m_entries.size();
+        }
+        if (m_hashes[slot - 1] == hash && header_names_equal(m_entries[slot - 1].first, name)) {
+            return slot - 1;
+        }
+    }
+}
+
+std::size_t Headers::index_slot(std::uint32_t hash) const {
+    return (hash ^ (hash >> 16)) & (m_index.size() - 1);
+}
+
+void Headers::index_insert(std::uint32_t hash, std::uint32_t index) {
+    const std::size_t mask = m_index.size() - 1;
+    std::size_t i = index_slot(hash);
+    while (m_index[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    m_index[i] = index + 1;
+}
+
+std::size_t Headers::first_of(std::string_view name, std::uint32_t hash) const {
+    return m_index.empty() ? find(name, hash) : indexed_find(name, hash);
+}
+
 std::string_view Headers::allocate_string(std::string_view sv) {
+    // Created on first use, since headers from the parser are only views
+    if (!m_pool) {
+        m_pool = std::make_unique<std::pmr::monotonic_buffer_resource>();
+    }
     void* ptr = m_pool->allocate(sv.size());
     std::memcpy(ptr, sv.data(), sv.size());
     return std::string_view(static_cast<char*>(ptr), sv.size());
@@ -25,22 +116,92 @@ void Headers::set(std::string header, std::string value) {
         throw std::invalid_argument("Invalid header value");
     }
 
-    unset(header);
+    auto hash = hash_header_name(header);
+    erase(header, hash);
 
     std::string_view header_view = allocate_string(header);
     std::string_view value_view = allocate_string(value);
 
-    m_map.emplace(header_view, value_view);
+    emplace(header_view, value_view, hash);
 }
 
-bool Headers::unset(std::string_view header) {
-    auto range = m_map.equal_range(header);
-    if (range.first != range.second) {
-        m_map.erase(range.first, range.second);
-        return true;
+void Headers::emplace(std::string_view header, std::string_view value, std::uint32_t hash) {
+    auto index = static_cast<std::uint32_t>(m_entries.size());
+    auto known = find_header(header);
+
+    // Only the first entry of a name is recorded in the lookups
+    bool first;
+    if (known.has_value()) {
+        first = m_known[static_cast<std::size_t>(*known)] == 0;
     } else {
+        first = m_index.empty() || indexed_find(header, hash) == m_entries.size();
+    }
+
+    m_entries.emplace_back(header, value);
+    m_hashes.push_back(hash);
+
+    if (known.has_value() && first) {
+        m_known[static_cast<std::size_t>(*known)] = index + 1;
+    }
+
+    if (m_entries.size() > INDEX_THRESHOLD) {
+        // Keeps the index at most half full, which also creates it past the threshold
+        if (m_entries.size() * 2 > m_index.size()) {
+            rebuild_lookups();
+        } else if (first) {
+            index_insert(hash, index);
+        }
+    }
+}
+
+void Headers::rebuild_lookups() {
+    m_known.fill(0);
+    m_index.clear();
+
+    bool indexed = m_entries.size() > INDEX_THRESHOLD;
+    if (indexed) {
+        m_index.resize(std::bit_ceil(m_entries.size() * 4));
+    }
+
+    for (std::size_t i = 0; i < m_entries.size(); i++) {
+        const auto& name = m_entries[i].first;
+        auto entry = static_cast<std::uint32_t>(i);
+
+        auto known = find_header(name);
+        if (known.has_value() && m_known[static_cast<std::size_t>(*known)] == 0) {
+            m_known[static_cast<std::size_t>(*known)] = entry + 1;
+        }
+        if (indexed && indexed_find(name, m_hashes[i]) == m_entries.size()) {
+            index_insert(m_hashes[i], entry);
+        }
+    }
+}
+
+bool Headers::unset(std::string_view header) {
+    return erase(header, hash_header_name(header));
+}
+
+bool Headers::erase(std::string_view header, std::uint32_t hash) {
+    auto first = first_of(header, hash);
+    if (first == m_entries.size()) {
         return false;
     }
+
+    // Compact the remaining entries in place, keeping their order
+    std::size_t out = first;
+    for (std::size_t i = first + 1; i < m_entries.size(); i++) {
+        if (m_hashes[i] == hash && header_names_equal(m_entries[i].first, header)) {
+            continue;
+        }
+        m_entries[out] = m_entries[i];
+        m_hashes[out] = m_hashes[i];
+        out++;
+    }
+    m_entries.truncate(out);
+    m_hashes.truncate(out);
+
+    rebuild_lookups();
+    return true;
 }
 
 void Headers::add(std::string header, std::string value) {
@@ -54,7 +215,7 @@ void Headers::add(std::string header, std::string value) {
     std::string_view header_view = allocate_string(header);
     std::string_view value_view = allocate_string(value);
 
-    m_map.emplace(header_view, value_view);
+    emplace(header_view, value_view, hash_header_name(header));
 }
 
 void Headers::set_view(std::string_view header, std::string_view value) {
@@ -65,9 +226,17 @@ void Headers::set_view(std::string_view header, std::string_view value) {
         throw std::invalid_argument("Invalid header value");
     }
 
-    unset(header);
+    auto hash = hash_header_name(header);
+    erase(header, hash);
+
+    emplace(header, value, hash);
+}
+
+void Headers::set_view_unchecked(std::string_view header, std::string_view value) {
+    auto hash = hash_header_name(header);
+    erase(header, hash);
 
-    m_map.emplace(header, value);
+    emplace(header, value, hash);
 }
 
 void Headers::add_view(std::string_view header, std::string_view value) {
@@ -78,20 +247,41 @@ void Headers::add_view(std::string_view header, std::string_view value) {
         throw std::invalid_argument("Invalid header value");
     }
 
-    m_map.emplace(header, value);
+    emplace(header, value, hash_header_name(header));
 }
 
 std::size_t Headers::size() const {
-    return m_map.size();
+    return m_entries.size();
+}
+
+std::pair<Headers::ValueIterator, Headers::ValueIterator>
+    Headers::get(std::string_view header) const {
+    auto hash = hash_header_name(header);
+    return {
+        ValueIterator(this, header, hash, first_of(header, hash)),
+        ValueIterator(this, header, hash, m_entries.size()),
+    };
 }
 
 std::optional<std::string_view> Headers::get_one(std::string_view header) const {
-    auto [start, end] = m_map.equal_range(header);
-    if (start != end) {
-        return start->second;
-    } else {
+    auto known = find_header(header);
+    if (known.has_value()) {
+        return get_one(*known);
+    }
+
+    auto index = first_of(header, hash_header_name(header));
+    if (index == m_entries.size()) {
+        return std::nullopt;
+    }
+    return m_entries[index].second;
+}
+
+std::optional<std::string_view> Headers::get_one(Header header) const {
+    auto slot = m_known[static_cast<std::size_t>(header)];
+    if (slot == 0) {
         return std::nullopt;
     }
+    return m_entries[slot - 1].second;
 }
 
 }
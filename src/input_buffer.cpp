@@ -0,0 +1,130 @@
+#include "httc/input_buffer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace httc {
+
+namespace {
+
+struct FreeBlocks {
+    std::size_t size;
+    std::vector<std::unique_ptr<char[]>> blocks;
+};
+
+// Connections of one server share a buffer size, so there are few sizes
+thread_local std::vector<FreeBlocks> free_blocks;
+
+FreeBlocks& free_blocks_of(std::size_t size) {
+    for (auto& free : free_blocks) {
+        if (free.size == size) {
+            return free;
+        }
+    }
+    return free_blocks.emplace_back(FreeBlocks{ size, {} });
+}
+
+}
+
+std::unique_ptr<char[]> BufferPool::acquire(std::size_t size) {
+    auto& free = free_blocks_of(size);
+    if (free.blocks.empty()) {
+        return std::make_unique_for_overwrite<char[]>(size);
+    }
+    auto block = std::move(free.blocks.back());
+    free.blocks.pop_back();
+    return block;
+}
+
+void BufferPool::release(std::unique_ptr<char[]> block, std::size_t size) {
+    auto& free = free_blocks_of(size);
+    if (free.blocks.size() < MAX_FREE_BLOCKS) {
+        free.blocks.push_back(std::move(block));
+    }
+}
+
+InputBuffer::InputBuffer(std::size_t capacity) : m_capacity(capacity) {
+}
+
+InputBuffer::~InputBuffer() {
+    if (m_storage) {
+        BufferPool::release(std::move(m_storage), m_capacity);
+    }
+}
+
+std::string_view InputBuffer::data() const {
+    return std::string_view(m_storage.get() + m_begin, m_end - m_begin);
+}
+
+std::size_t InputBuffer::size() const {
+    return m_end - m_begin;
+}
+
+bool InputBuffer::empty() const {
+    return m_begin == m_end;
+}
+
+std::size_t InputBuffer::capacity() const {
+    return m_capacity;
+}
+
+std::size_t InputBuffer::append(std::string_view bytes) {
+    if (bytes.empty()) {
+        return 0;
+    }
+    auto free = prepare();
+    auto n = std::min(bytes.size(), free.size());
+    std::memcpy(free.data(), bytes.data(), n);
+    commit(n);
+    return n;
+}
+
+std::span<char> InputBuffer::prepare() {
+    if (!m_storage) {
+        m_storage = BufferPool::acquire(m_capacity);
+    }
+    make_room();
+    return std::span(m_storage.get() + m_end, m_capacity - m_end);
+}
+
+void InputBuffer::commit(std::size_t n) {
+    m_end += n;
+}
+
+void InputBuffer::consume(std::size_t n) {
+    m_begin += n;
+    if (m_begin == m_end) {
+        m_begin = 0;
+        m_end = 0;
+    }
+}
+
+void InputBuffer::clear() {
+    m_begin = 0;
+    m_end = 0;
+}
+
+void InputBuffer::release() {
+    if (m_storage && empty()) {
+        BufferPool::release(std::move(m_storage), m_capacity);
+        m_begin = 0;
+        m_end = 0;
+    }
+}
+
+bool InputBuffer::holds_storage() const {
+    return m_storage != nullptr;
+}
+
+void InputBuffer::make_room() {
+    if (m_begin == 0 || m_capacity - m_end >= m_begin) {
+        return;
+    }
+
+    std::memmove(m_storage.get(), m_storage.get() + m_begin, m_end - m_begin);
+    m_end -= m_begin;
+    m_begin = 0;
+}
+
+}
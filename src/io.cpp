@@ -1,34 +1,112 @@
 #include "httc/io.hpp"
 #include <asio.hpp>
+#include <cerrno>
+#include <system_error>
+#include <utility>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
 
 namespace httc {
 
 SocketReader::SocketReader(asio::ip::tcp::socket& socket, const ServerConfig& cfg)
 : m_sock(socket), m_cfg(cfg) {
+    // Only affects the synchronous reads after wait(). Without it they are skipped
+    asio::error_code ec;
+    m_sock.non_blocking(true, ec);
 }
 
 asio::awaitable<std::expected<std::string_view, ReaderError>> SocketReader::pull() {
+    if (!m_buffer) {
+        m_buffer = std::make_unique<char[]>(BUFFER_SIZE);
+    }
+
+    auto n = co_await pull_into(std::span(m_buffer.get(), BUFFER_SIZE));
+    if (!n.has_value()) {
+        co_return std::unexpected(n.error());
+    }
+
+    co_return std::string_view(m_buffer.get(), *n);
+}
+
+asio::awaitable<std::expected<std::size_t, ReaderError>>
+    SocketReader::pull_into(std::span<char> buffer) {
     std::size_t n = 0;
     asio::error_code ec;
-    n = co_await m_sock.async_read_some(
-        asio::buffer(m_buffer), asio::redirect_error(asio::use_awaitable, ec)
+    auto asio_buffer = asio::buffer(buffer.data(), buffer.size());
+
+    // After wait() the data is already there, and a non-blocking read takes it without another
+    // asynchronous operation
+    if (std::exchange(m_readable, false) && m_sock.non_blocking()) {
+        n = m_sock.read_some(asio_buffer, ec);
+        if (!ec) {
+            co_return n;
+        }
+        if (ec != asio::error::would_block && ec != asio::error::try_again) {
+            co_return std::unexpected(reader_error(ec));
+        }
+        ec.clear();
+    }
+
+    n = co_await m_sock.async_read_some(asio_buffer, asio::redirect_error(asio::use_awaitable, ec));
+    if (ec) {
+        co_return std::unexpected(reader_error(ec));
+    }
+
+    co_return n;
+}
+
+asio::awaitable<std::expected<void, ReaderError>> SocketReader::wait() {
+    asio::error_code ec;
+    co_await m_sock.async_wait(
+        asio::ip::tcp::socket::wait_read, asio::redirect_error(asio::use_awaitable, ec)
     );
+    if (ec) {
+        co_return std::unexpected(reader_error(ec));
+    }
 
+    m_readable = true;
+    co_return std::expected<void, ReaderError>{};
+}
+
+ReaderError SocketReader::reader_error(const asio::error_code& ec) {
     if (ec == asio::error::eof) {
-        co_return std::unexpected(ReaderError::CLOSED);
+        return ReaderError::CLOSED;
     } else if (ec == asio::error::operation_aborted) {
-        co_return std::unexpected(ReaderError::TIMEOUT);
-    } else if (ec) {
-        co_return std::unexpected(ReaderError::UNKNOWN);
+        return ReaderError::TIMEOUT;
     }
-
-    co_return std::string_view(m_buffer.data(), n);
+    return ReaderError::UNKNOWN;
 }
 
 SocketWriter::SocketWriter(asio::ip::tcp::socket& socket) : m_sock(socket) {
 }
 
-asio::awaitable<void> SocketWriter::write(std::vector<asio::const_buffer> buffers) {
+asio::awaitable<void> SocketWriter::write(WriteBuffers buffers) {
     co_await asio::async_write(m_sock, buffers, asio::use_awaitable);
 }
+
+#if defined(__linux__)
+asio::awaitable<void> SocketWriter::send_file(int fd, std::uint64_t offset, std::size_t size) {
+    // sendfile(2) must return instead of blocking the thread when the send buffer is full
+    if (!m_sock.non_blocking()) {
+        m_sock.non_blocking(true);
+    }
+
+    auto file_offset = static_cast<off_t>(offset);
+    while (size > 0) {
+        auto n = ::sendfile(m_sock.native_handle(), fd, &file_offset, size);
+        if (n > 0) {
+            size -= static_cast<std::size_t>(n);
+        } else if (n == 0) {
+            // The file is shorter than it was
+            throw std::system_error(asio::error::make_error_code(asio::error::eof));
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            co_await m_sock.async_wait(asio::ip::tcp::socket::wait_write, asio::use_awaitable);
+        } else if (errno != EINTR) {
+            throw std::system_error(errno, std::system_category(), "sendfile");
+        }
+    }
+}
+#endif
+
 }
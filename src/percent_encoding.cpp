@@ -1,48 +1,259 @@
 #include "httc/percent_encoding.hpp"
-#include <format>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace httc {
 
-bool isUnreserved(char c) {
-    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-'
-           || c == '.' || c == '_' || c == '~';
+namespace {
+
+// Value of each hex digit, or -1
+constexpr auto HEX_VALUES = [] {
+    std::array<std::int8_t, 256> table{};
+    for (std::size_t c = 0; c < table.size(); c++) {
+        if (c >= '0' && c <= '9') {
+            table[c] = static_cast<std::int8_t>(c - '0');
+        } else if (c >= 'A' && c <= 'F') {
+            table[c] = static_cast<std::int8_t>(c - 'A' + 10);
+        } else if (c >= 'a' && c <= 'f') {
+            table[c] = static_cast<std::int8_t>(c - 'a' + 10);
+        } else {
+            table[c] = -1;
+        }
+    }
+    return table;
+}();
+
+constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// https://www.rfc-editor.org/rfc/rfc3986#section-2.3
+constexpr auto UNRESERVED = [] {
+    std::array<bool, 256> table{};
+    for (std::size_t c = 0; c < table.size(); c++) {
+        table[c] = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+                   || c == '-' || c == '.' || c == '_' || c == '~';
+    }
+    return table;
+}();
+
+#if defined(__AVX2__)
+using Block = __m256i;
+constexpr std::size_t BLOCK_SIZE = 32;
+
+Block load(const char* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const Block*>(p));
+}
+Block splat(char c) {
+    return _mm256_set1_epi8(c);
+}
+Block eq(Block a, Block b) {
+    return _mm256_cmpeq_epi8(a, b);
+}
+Block or_(Block a, Block b) {
+    return _mm256_or_si256(a, b);
 }
+Block and_(Block a, Block b) {
+    return _mm256_and_si256(a, b);
+}
+// Unsigned lo <= a <= hi for every byte
+Block in_range(Block a, char lo, char hi) {
+    auto ge = eq(_mm256_max_epu8(a, splat(lo)), a);
+    auto le = eq(_mm256_min_epu8(a, splat(hi)), a);
+    return and_(ge, le);
+}
+std::uint32_t mask(Block a) {
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(a));
+}
+#elif defined(__SSE2__)
+using Block = __m128i;
+constexpr std::size_t BLOCK_SIZE = 16;
 
-bool isHex(char c) {
-    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
+Block load(const char* p) {
+    return _mm_loadu_si128(reinterpret_cast<const Block*>(p));
+}
+Block splat(char c) {
+    return _mm_set1_epi8(c);
 }
+Block eq(Block a, Block b) {
+    return _mm_cmpeq_epi8(a, b);
+}
+Block or_(Block a, Block b) {
+    return _mm_or_si128(a, b);
+}
+Block and_(Block a, Block b) {
+    return _mm_and_si128(a, b);
+}
+// Unsigned lo <= a <= hi for every byte
+Block in_range(Block a, char lo, char hi) {
+    auto ge = eq(_mm_max_epu8(a, splat(lo)), a);
+    auto le = eq(_mm_min_epu8(a, splat(hi)), a);
+    return and_(ge, le);
+}
+std::uint32_t mask(Block a) {
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(a));
+}
+#endif
 
-std::optional<std::string> percent_decode(const std::string& str) {
-    std::string result;
+#if defined(__AVX2__) || defined(__SSE2__)
+// Marks the unreserved bytes. Setting 0x20 folds upper case letters onto lower case ones, and
+// moves no other byte into a-z
+Block unreserved(Block b) {
+    auto alpha = in_range(or_(b, splat(0x20)), 'a', 'z');
+    auto digit = in_range(b, '0', '9');
+    auto marks = or_(
+        or_(eq(b, splat('-')), eq(b, splat('.'))), or_(eq(b, splat('_')), eq(b, splat('~')))
+    );
+    return or_(or_(alpha, digit), marks);
+}
+#endif
+
+// Returns the offset of the first '%' at or after `from`, or str.size()
+std::size_t find_percent(std::string_view str, std::size_t from) {
+    std::size_t i = from;
 
-    for (size_t i = 0; i < str.size(); i++) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + BLOCK_SIZE <= str.size(); i += BLOCK_SIZE) {
+        auto found = mask(eq(load(str.data() + i), splat('%')));
+        if (found != 0) {
+            return i + std::countr_zero(found);
+        }
+    }
+#endif
+
+    // Scalar tail, or the whole input without SIMD support
+    for (; i < str.size(); i++) {
         if (str[i] == '%') {
-            if (i + 2 >= str.size() || !isHex(str[i + 1]) || !isHex(str[i + 2])) {
-                return std::nullopt; // Invalid percent-encoding
-            }
-            std::string hex = str.substr(i + 1, 2);
-            char decoded_char = static_cast<char>(std::stoi(hex, nullptr, 16));
-            result += decoded_char;
-            i += 2;
-        } else {
-            result += str[i];
+            return i;
         }
     }
+    return str.size();
+}
 
-    return result;
+// Returns the offset of the first byte at or after `from` that must be encoded, or str.size()
+std::size_t find_reserved(std::string_view str, std::size_t from) {
+    std::size_t i = from;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + BLOCK_SIZE <= str.size(); i += BLOCK_SIZE) {
+        // Only the low BLOCK_SIZE bits of the mask are used
+        auto found = ~mask(unreserved(load(str.data() + i)))
+                     & static_cast<std::uint32_t>((std::uint64_t{ 1 } << BLOCK_SIZE) - 1);
+        if (found != 0) {
+            return i + std::countr_zero(found);
+        }
+    }
+#endif
+
+    for (; i < str.size(); i++) {
+        if (!UNRESERVED[static_cast<unsigned char>(str[i])]) {
+            return i;
+        }
+    }
+    return str.size();
+}
+
+}
+
+std::optional<std::size_t> percent_decode(std::string_view str, char* out) {
+    std::size_t i = 0;
+    std::size_t size = 0;
+    while (true) {
+        // Runs without escapes are copied as a whole, or left alone when decoding in place
+        auto next = find_percent(str, i);
+        if (next > i && out + size != str.data() + i) {
+            std::memmove(out + size, str.data() + i, next - i);
+        }
+        size += next - i;
+        i = next;
+
+        if (i == str.size()) {
+            return size;
+        }
+        if (i + 2 >= str.size()) {
+            return std::nullopt;
+        }
+        auto high = HEX_VALUES[static_cast<unsigned char>(str[i + 1])];
+        auto low = HEX_VALUES[static_cast<unsigned char>(str[i + 2])];
+        if ((high | low) < 0) {
+            return std::nullopt;
+        }
+        out[size++] = static_cast<char>(high << 4 | low);
+        i += 3;
+    }
+}
+
+std::optional<std::size_t> percent_decode_in_place(char* str, std::size_t size) {
+    return percent_decode(std::string_view(str, size), str);
 }
 
-std::string percent_encode(const std::string& str) {
+std::optional<std::string> percent_decode(std::string_view str) {
     std::string result;
+    bool valid = true;
+    result.resize_and_overwrite(str.size(), [&](char* out, std::size_t) {
+        auto size = percent_decode(str, out);
+        valid = size.has_value();
+        return size.value_or(0);
+    });
 
-    for (unsigned char c : str) {
-        if (isUnreserved(c)) {
-            result += c;
-        } else {
-            result += std::format("%{:02X}", static_cast<int>(c));
+    if (!valid) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+bool valid_percent_encoding(std::string_view str) {
+    for (auto i = find_percent(str, 0); i < str.size(); i = find_percent(str, i + 3)) {
+        if (i + 2 >= str.size() || HEX_VALUES[static_cast<unsigned char>(str[i + 1])] < 0
+            || HEX_VALUES[static_cast<unsigned char>(str[i + 2])] < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t percent_encoded_size(std::string_view str) {
+    std::size_t size = str.size();
+    for (auto i = find_reserved(str, 0); i < str.size(); i = find_reserved(str, i + 1)) {
+        size += 2;
+    }
+    return size;
+}
+
+char* percent_encode(std::string_view str, char* out) {
+    std::size_t i = 0;
+    while (true) {
+        // Runs of unreserved bytes are copied as a whole
+        auto next = find_reserved(str, i);
+        if (next > i) {
+            std::memcpy(out, str.data() + i, next - i);
+            out += next - i;
         }
+        i = next;
+
+        if (i == str.size()) {
+            return out;
+        }
+        auto c = static_cast<unsigned char>(str[i++]);
+        out[0] = '%';
+        out[1] = HEX_DIGITS[c >> 4];
+        out[2] = HEX_DIGITS[c & 0xF];
+        out += 3;
     }
+}
 
+std::string percent_encode(std::string_view str) {
+    auto size = percent_encoded_size(str);
+    std::string result;
+    result.resize_and_overwrite(size, [&](char* out, std::size_t) {
+        return percent_encode(str, out) - out;
+    });
     return result;
 }
 
@@ -1,8 +1,27 @@
 #include "httc/request.hpp"
+#include <stdexcept>
 #include <string_view>
 
 namespace httc {
 
+bool PathParams::contains(std::string_view name) const {
+    for (const auto& param : m_params) {
+        if (param.first == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view PathParams::at(std::string_view name) const {
+    for (const auto& param : m_params) {
+        if (param.first == name) {
+            return param.second;
+        }
+    }
+    throw std::out_of_range(std::format("No path param named '{}'", name));
+}
+
 Request::Request() : uri(*URI::parse("/")) {
 }
 
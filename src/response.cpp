@@ -1,4 +1,5 @@
 #include "httc/response.hpp"
+#include <algorithm>
 #include <asio.hpp>
 #include <asio/awaitable.hpp>
 #include <asio/error_code.hpp>
@@ -32,14 +33,21 @@ void Response::generate_head() {
     m_head_buffer.append("\r\n");
 }
 
-asio::awaitable<void> Response::write_to_writer(std::vector<asio::const_buffer> buffers) {
-    co_return co_await m_write_fn(m_writer_ptr, std::move(buffers));
+// The write functions below are not coroutines: they return the awaitable of the writer, so a
+// write only costs the coroutine frame of the writer
+asio::awaitable<void> Response::write_to_writer(WriteBuffers buffers) {
+    return m_write_fn(m_writer_ptr, buffers);
 }
 
-Response Response::from_status(SocketWriter& writer, StatusCode status) {
-    Response r(writer);
-    r.status = status;
-    return r;
+asio::awaitable<void> Response::flush_writer() {
+    if (m_flush_fn == nullptr) {
+        return no_write();
+    }
+    return m_flush_fn(m_writer_ptr);
+}
+
+asio::awaitable<void> Response::no_write() {
+    co_return;
 }
 
 asio::awaitable<Response::ChunkedStream> Response::send_chunked() {
@@ -76,27 +84,55 @@ asio::awaitable<Response::FixedStream> Response::send_fixed(std::size_t content_
 asio::awaitable<void> Response::ChunkedStream::write(std::string_view chunk) {
     if (chunk.size() == 0) {
         // Do not write empty chunks because that indicates the end of the stream
-        co_return;
+        return no_write();
     }
 
-    auto chunk_size = std::format("{:X}\r\n", chunk.size());
+    // Kept in the response, which outlives the write
+    auto& chunk_size = m_parent.m_chunk_size;
+    auto n = std::format_to_n(chunk_size.data(), chunk_size.size(), "{:X}\r\n", chunk.size()).size;
 
-    co_return co_await m_parent.write_to_writer(
-        {
-            asio::buffer(chunk_size),
-            asio::buffer(chunk),
-            asio::buffer("\r\n", 2),
-        }
-    );
+    return m_parent.write_to_writer({
+        asio::buffer(chunk_size.data(), n),
+        asio::buffer(chunk),
+        asio::buffer("\r\n", 2),
+    });
+}
+
+asio::awaitable<void> Response::ChunkedStream::flush() {
+    return m_parent.flush_writer();
 }
 
 asio::awaitable<void> Response::ChunkedStream::end() {
     m_parent.m_state = State::Sent;
-    co_return co_await m_parent.write_to_writer({ asio::buffer("0\r\n\r\n", 5) });
+    return m_parent.write_to_writer({ asio::buffer("0\r\n\r\n", 5) });
 }
 
 asio::awaitable<void> Response::FixedStream::write(std::string_view data) {
-    co_return co_await m_parent.write_to_writer({ asio::buffer(data) });
+    return m_parent.write_to_writer({ asio::buffer(data) });
+}
+
+asio::awaitable<void> Response::FixedStream::write_file(asio::stream_file& file, std::size_t size) {
+    if (m_parent.m_send_file_fn != nullptr && size >= MIN_SEND_FILE_SIZE) {
+        auto offset = file.seek(0, asio::file_base::seek_cur);
+        co_await m_parent.m_send_file_fn(
+            m_parent.m_writer_ptr, file.native_handle(), offset, size
+        );
+        file.seek(static_cast<std::int64_t>(size), asio::file_base::seek_cur);
+        co_return;
+    }
+
+    char buffer[8192];
+    while (size > 0) {
+        std::size_t n = co_await file.async_read_some(
+            asio::buffer(buffer, std::min(size, sizeof(buffer))), asio::use_awaitable
+        );
+        co_await write(std::string_view(buffer, n));
+        size -= n;
+    }
+}
+
+asio::awaitable<void> Response::FixedStream::flush() {
+    return m_parent.flush_writer();
 }
 
 awaitable<void> Response::send() {
@@ -107,25 +143,24 @@ awaitable<void> Response::send() {
 
     case State::StreamChunk:
         // Send the last close
-        co_return co_await write_to_writer({ asio::buffer("0\r\n\r\n", 5) });
+        return write_to_writer({ asio::buffer("0\r\n\r\n", 5) });
 
     case State::StreamFixed:
-        co_return;
+        return no_write();
 
     case State::Body:
         break;
 
     case State::Sent:
-        co_return;
+        return no_write();
     }
 
     generate_head();
-    std::vector<asio::const_buffer> buffers;
-    buffers.push_back(asio::buffer(m_head_buffer));
+    WriteBuffers buffers{ asio::buffer(m_head_buffer) };
     if (!m_head && !m_body.empty()) {
         buffers.push_back(asio::buffer(m_body));
     }
-    co_return co_await write_to_writer(buffers);
+    return m_write_fn(m_writer_ptr, buffers);
 }
 
 void Response::set_body(std::string_view body) {
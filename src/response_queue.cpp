@@ -0,0 +1,47 @@
+#include "httc/response_queue.hpp"
+#include <asio/redirect_error.hpp>
+#include <asio/use_awaitable.hpp>
+
+namespace httc {
+
+ResponseQueue::ResponseQueue(asio::any_io_executor executor, std::size_t max_slot_output)
+: m_changed(executor, asio::steady_timer::time_point::max()), m_max_slot_output(max_slot_output) {
+}
+
+asio::awaitable<void> ResponseQueue::SlotWriter::write(WriteBuffers buffers) {
+    for (const auto& buffer : buffers) {
+        m_slot->output.append(static_cast<const char*>(buffer.data()), buffer.size());
+    }
+    m_queue->notify();
+
+    while (m_slot->output.size() > m_queue->m_max_slot_output && !m_queue->m_stopped) {
+        co_await m_queue->wait();
+    }
+}
+
+std::shared_ptr<ResponseSlot> ResponseQueue::push() {
+    auto slot = std::make_shared<ResponseSlot>();
+    m_slots.push_back(slot);
+    return slot;
+}
+
+ResponseQueue::SlotWriter ResponseQueue::writer(std::shared_ptr<ResponseSlot> slot) {
+    return SlotWriter(shared_from_this(), std::move(slot));
+}
+
+void ResponseQueue::notify() {
+    m_changed.cancel();
+}
+
+asio::awaitable<void> ResponseQueue::wait() {
+    // Cancellation by notify() is the expected way to wake up
+    asio::error_code ec;
+    co_await m_changed.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+}
+
+void ResponseQueue::close() {
+    m_closed = true;
+    notify();
+}
+
+}
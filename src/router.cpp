@@ -6,7 +6,8 @@
 namespace httc {
 
 void Router::add_route(
-    HandlerFn f, std::string_view path, std::optional<std::vector<std::string>> methods
+    HandlerFn f, std::string_view path, std::optional<MethodSet> methods, RouteOptions options,
+    std::vector<std::string> custom_methods
 ) {
     auto uri_opt = URI::parse(path);
     if (!uri_opt.has_value() || !uri_opt->query().empty()) {
@@ -14,153 +15,357 @@ void Router::add_route(
     }
     URI uri = *uri_opt;
 
-    for (auto& handlers : m_handlers) {
-        auto match = handlers.path.match(uri);
-        if (match == URIMatch::FULL_MATCH) {
-            if (!methods.has_value()) {
-                if (handlers.global_handler.has_value()) {
-                    throw URICollision(uri, handlers.path);
-                }
+    // Routes that only differ by the names of their params share a node
+    auto& route = insert_route(uri);
+    if (!methods.has_value()) {
+        if (route.global_handler != nullptr) {
+            throw URICollision(uri, route.path);
+        }
+    } else if (route.methods.intersects(*methods)) {
+        throw URICollision(uri, route.path);
+    }
+    for (const auto& token : custom_methods) {
+        for (const auto& [other, _] : route.custom_handlers) {
+            if (token == other) {
+                throw URICollision(uri, route.path);
+            }
+        }
+    }
 
-                handlers.global_handler = f;
+    auto& handler = route.handlers.emplace_back(
+        std::make_unique<RouteHandler>(RouteHandler{ std::move(f), options })
+    );
+    if (!methods.has_value()) {
+        route.global_handler = handler.get();
+    } else {
+        add_method_handlers(route, *methods, handler.get());
+        for (auto& token : custom_methods) {
+            route.custom_handlers.emplace_back(std::move(token), handler.get());
+        }
+    }
+}
 
-                return;
-            }
+void Router::add_method_handlers(
+    HandlerPath& path, MethodSet methods, const RouteHandler* handler
+) {
+    for (std::size_t i = 0; i < Method::COUNT; i++) {
+        auto method = static_cast<Method::Id>(i);
+        if (methods.contains(method)) {
+            path.method_handlers[i] = handler;
+            path.methods.insert(method);
+        }
+    }
+}
+
+Router::HandlerPath& Router::insert_route(const URI& uri) {
+    auto segments = uri.paths();
+    Node* node = &m_root;
 
-            for (const auto& method : *methods) {
-                if (handlers.method_handlers.contains(method)) {
-                    throw URICollision(uri, handlers.path);
-                }
+    std::size_t i = 0;
+    while (i < segments.size()) {
+        auto segment = segments[i];
+        if (segment == "*") {
+            // Always the last segment
+            if (!node->wildcard) {
+                node->wildcard = std::make_unique<Node>();
             }
-            for (const auto& method : *methods) {
-                handlers.method_handlers[method] = f;
+            node = node->wildcard.get();
+            break;
+        }
+        if (segment.starts_with(':')) {
+            if (!node->param) {
+                node->param = std::make_unique<Node>();
             }
-            return;
+            node = node->param.get();
+            i++;
+            continue;
         }
-    }
 
-    HandlerPath new_handler(uri);
-    if (methods.has_value()) {
-        for (const auto& method : *methods) {
-            new_handler.method_handlers[method] = f;
+        auto it = node->children.find(segment);
+        if (it == node->children.end()) {
+            // A new child takes every static segment up to the next param or wildcard
+            auto child = std::make_unique<Node>();
+            while (i < segments.size() && segments[i] != "*" && !segments[i].starts_with(':')) {
+                child->label.emplace_back(segments[i]);
+                i++;
+            }
+            auto key = child->label.front();
+            node = node->children.emplace(std::move(key), std::move(child)).first->second.get();
+            continue;
         }
-    } else {
-        new_handler.global_handler = f;
+
+        Node* child = it->second.get();
+        std::size_t common = 1;
+        while (common < child->label.size() && i + common < segments.size()
+               && child->label[common] == segments[i + common]) {
+            common++;
+        }
+
+        if (common < child->label.size()) {
+            // Split the child where the path leaves its label
+            auto rest = std::make_unique<Node>();
+            rest->label.assign(child->label.begin() + common, child->label.end());
+            rest->children = std::move(child->children);
+            rest->param = std::move(child->param);
+            rest->wildcard = std::move(child->wildcard);
+            rest->route = std::move(child->route);
+
+            child->label.resize(common);
+            child->children.clear();
+            auto key = rest->label.front();
+            child->children.emplace(std::move(key), std::move(rest));
+        }
+
+        node = child;
+        i += common;
     }
-    m_handlers.push_back(std::move(new_handler));
+
+    if (!node->route) {
+        node->route = std::make_unique<HandlerPath>(uri);
+    }
+    return *node->route;
 }
 
 Router& Router::wrap(MiddlewareFn middleware) {
-    m_middleware.push_back(middleware);
+    m_middleware.push_back(std::move(middleware));
     return *this;
 }
 
-asio::awaitable<void>
-    Router::run_handler(HandlerFn f, const URI& handler_path, Request& req, Response& res) const {
+asio::awaitable<void> Router::run_handler(
+    const HandlerFn& f, const RouteMatch& route, Request& req, Response& res
+) const {
     auto req_paths = req.uri.paths();
-    auto handler_paths = handler_path.paths();
-    for (size_t i = 0; i < handler_paths.size(); i++) {
-        if (handler_paths[i] == "*") {
-            req.wildcard_path = "";
-            for (size_t j = i; j < req_paths.size(); j++) {
-                if (j > i) {
-                    req.wildcard_path += "/";
-                }
-                req.wildcard_path += req_paths[j];
+    auto handler_paths = static_cast<const HandlerPath*>(route.route)->path.paths();
+    req.path_params.clear();
+    for (auto i : route.params) {
+        req.path_params.add(handler_paths[i].substr(1), req_paths[i]);
+    }
+    req.wildcard_path = {};
+    if (route.wildcard.has_value()) {
+        req.wildcard_path = req.uri.path_from(*route.wildcard);
+    }
+
+    co_await Next(m_middleware, f, req, res)(req, res);
+}
+
+asio::awaitable<void> Next::operator()(const Request&, Response&) const {
+    if (m_middleware.empty()) {
+        return (*m_handler)(*m_req, *m_res);
+    }
+    Next next = *this;
+    next.m_middleware = m_middleware.subspan(1);
+    return m_middleware.front()(*m_req, *m_res, next);
+}
+
+// State of a walk of the route tree for one request. The walk tries static children first, then
+// the param child, then the wildcard child, and keeps the first route it reaches in each category
+struct Router::Search {
+    enum Category {
+        FULL,
+        PARAM,
+        WILD,
+    };
+
+    URI::Paths paths;
+    Method::Id method;
+    // Token of the method, matched against the custom methods of a route when it is OTHER
+    std::string_view token;
+    // Segments matched by the params on the way to the current node
+    SmallVector<std::uint32_t, 8> params;
+    std::optional<RouteMatch> matches[3];
+
+    // Returns true if the route has a handler for the method of the request
+    bool select_handler(const HandlerPath& route, RouteMatch& match) const {
+        if (route.methods.contains(method)) {
+            match.handler = route.method_handlers[method];
+        } else if (auto custom = custom_handler(route)) {
+            match.handler = custom;
+        } else if (route.global_handler != nullptr) {
+            match.handler = route.global_handler;
+        } else if (method == Method::HEAD && route.methods.contains(Method::GET)) {
+            match.handler = route.method_handlers[Method::GET];
+            match.head_as_get = true;
+        } else if (method == Method::OPTIONS) {
+            // Default OPTIONS handler
+            match.handler = nullptr;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    const RouteHandler* custom_handler(const HandlerPath& route) const {
+        if (method != Method::OTHER) {
+            return nullptr;
+        }
+        for (const auto& [other, handler] : route.custom_handlers) {
+            if (other == token) {
+                return handler;
             }
-            break;
-        } else if (!handler_paths[i].empty() && handler_paths[i][0] == ':') {
-            auto param_name = handler_paths[i].substr(1);
-            req.path_params[param_name] = req_paths[i];
         }
+        return nullptr;
     }
 
-    auto& mw_vec = m_middleware;
-    size_t middleware_idx = 0;
-    auto run_middleware = [&](this const auto& self) -> asio::awaitable<void> {
-        if (middleware_idx < mw_vec.size()) {
-            auto& mw = mw_vec[middleware_idx];
-            middleware_idx++;
-            co_await mw(req, res, [&](const Request&, Response&) -> asio::awaitable<void> {
-                co_await self();
-            });
-        } else {
-            co_await f(req, res);
+    // Records a route that matches the path. Returns true if no better match can be found.
+    // Routes with only static segments are reached first, and routes with params are reached
+    // after them, so a usable full or param match ends the walk
+    bool add(Category category, const HandlerPath& route, std::optional<std::size_t> wildcard) {
+        if (matches[category].has_value()) {
+            return false;
+        }
+
+        RouteMatch match{ .route = &route };
+        match.params = params;
+        match.wildcard = wildcard;
+        bool usable = select_handler(route, match);
+        if (!usable) {
+            match.method_not_allowed = true;
+        }
+        matches[category] = std::move(match);
+        return usable && category != WILD;
+    }
+
+    // Walks the subtree of `node`, which matched the first `i` segments of the path.
+    // Returns true once the walk can stop
+    bool walk(const Node& node, std::size_t i) {
+        if (i == paths.size()) {
+            if (node.route && add(params.empty() ? FULL : PARAM, *node.route, std::nullopt)) {
+                return true;
+            }
+            // A wildcard also matches nothing, so /files/* matches /files
+            if (node.wildcard && node.wildcard->route) {
+                add(WILD, *node.wildcard->route, i);
+            }
+            return false;
         }
-    };
-    co_await run_middleware();
-}
 
-asio::awaitable<void> Router::handle(Request& req, Response& res) const {
-    // [0] = full match
-    // [1] = param match
-    // [2] = wildcard match
-    const HandlerPath* matches[3] = {};
+        auto segment = paths[i];
+        auto it = node.children.find(segment);
+        if (it != node.children.end()) {
+            const Node& child = *it->second;
+            if (label_matches(child.label, i) && walk(child, i + child.label.size())) {
+                return true;
+            }
+        }
+
+        // A param does not match an empty segment
+        if (node.param && !segment.empty()) {
+            params.push_back(static_cast<std::uint32_t>(i));
+            if (walk(*node.param, i + 1)) {
+                return true;
+            }
+            params.truncate(params.size() - 1);
+        }
 
-    for (const auto& handler : m_handlers) {
-        auto match = handler.path.match(req.uri);
-        if (match == URIMatch::FULL_MATCH) {
-            matches[0] = &handler;
-        } else if (match == URIMatch::PARAM_MATCH) {
-            matches[1] = &handler;
-        } else if (match == URIMatch::WILD_MATCH) {
-            matches[2] = &handler;
+        if (node.wildcard && node.wildcard->route) {
+            add(WILD, *node.wildcard->route, i);
         }
+        return false;
     }
 
-    bool method_not_allowed = false;
-    for (const auto m : matches) {
-        if (m != nullptr) {
-            if (m->method_handlers.contains(req.method)) {
-                co_return co_await run_handler(
-                    m->method_handlers.at(req.method), m->path, req, res
-                );
-            } else if (m->global_handler.has_value()) {
-                co_return co_await run_handler(*m->global_handler, m->path, req, res);
-            } else if (req.method == "HEAD" && m->method_handlers.contains("GET")) {
-                req.method = "GET";
-                co_return co_await run_handler(m->method_handlers.at("GET"), m->path, req, res);
-            } else if (req.method == "OPTIONS") {
-                co_return co_await run_handler(
-                    [this, &m](const Request& req, Response& res) -> asio::awaitable<void> {
-                        this->default_options_handler(m, res);
-                        co_return;
-                    },
-                    m->path, req, res
-                );
-            } else {
-                method_not_allowed = true;
+    // The first segment of the label is known to match
+    bool label_matches(const std::vector<std::string>& label, std::size_t i) const {
+        if (i + label.size() > paths.size()) {
+            return false;
+        }
+        for (std::size_t j = 1; j < label.size(); j++) {
+            if (label[j] != paths[i + j]) {
+                return false;
             }
         }
+        return true;
+    }
+};
+
+asio::awaitable<void> RouterBase::handle(Request& req, Response& res) const {
+    // Awaited here, so the route outlives the handler
+    auto route = find_route(req);
+    co_await handle(route, req, res);
+}
+
+RouteMatch Router::find_route(const Request& req) const {
+    Search search{
+        .paths = req.uri.paths(), .method = req.method.id(), .token = req.method.name()
+    };
+    search.walk(m_root, 0);
+
+    // Full matches come before param matches, which come before wildcard matches. A match
+    // without a handler for the method is skipped, and ends in a 405 if nothing else matches
+    bool method_not_allowed = false;
+    for (auto& match : search.matches) {
+        if (!match.has_value()) {
+            continue;
+        }
+        if (!match->method_not_allowed) {
+            auto handler = static_cast<const RouteHandler*>(match->handler);
+            match->stream_body = handler != nullptr && handler->options.stream_body;
+            return std::move(*match);
+        }
+        method_not_allowed = true;
     }
 
-    if (method_not_allowed) {
-        res.status = StatusCode::METHOD_NOT_ALLOWED;
+    return { .method_not_allowed = method_not_allowed };
+}
+
+asio::awaitable<void>
+    Router::handle(const RouteMatch& route, Request& req, Response& res) const {
+    if (route.route == nullptr) {
+        if (route.method_not_allowed) {
+            res.status = StatusCode::METHOD_NOT_ALLOWED;
+        } else {
+            res.status = StatusCode::NOT_FOUND;
+        }
         co_return;
     }
 
-    res.status = StatusCode::NOT_FOUND;
+    if (route.handler == nullptr) {
+        auto m = static_cast<const HandlerPath*>(route.route);
+        HandlerFn options = [this, m](const Request&, Response& res) -> asio::awaitable<void> {
+            this->default_options_handler(m, res);
+            co_return;
+        };
+        co_return co_await run_handler(options, route, req, res);
+    }
+
+    if (route.head_as_get) {
+        req.method = Method::GET;
+    }
+    co_await run_handler(static_cast<const RouteHandler*>(route.handler)->fn, route, req, res);
 }
 
 void Router::default_options_handler(const HandlerPath* handler, Response& res) const {
     res.status = StatusCode::OK;
-
-    std::string allow;
     // No need to check global_handler, because if it exists
     // it would handle this request instead of calling this function.
-    for (const auto& [method, _] : handler->method_handlers) {
+    std::vector<std::string_view> custom;
+    for (const auto& [token, _] : handler->custom_handlers) {
+        custom.push_back(token);
+    }
+    res.headers.set("Allow", allow_header(handler->methods, custom));
+}
+
+std::string allow_header(MethodSet methods, std::span<const std::string_view> custom) {
+    std::string allow;
+    for (std::size_t i = 0; i < Method::COUNT; i++) {
+        auto method = static_cast<Method::Id>(i);
+        if (!methods.contains(method)) {
+            continue;
+        }
         if (!allow.empty()) {
             allow += ", ";
         }
-        allow += method;
+        allow += Method::name(method);
     }
     if (allow.empty()) {
         allow = "OPTIONS, HEAD";
     } else {
         allow += ", OPTIONS, HEAD";
     }
-
-    res.headers.set("Allow", allow);
+    for (auto token : custom) {
+        allow += ", ";
+        allow += token;
+    }
+    return allow;
 }
 
 }
@@ -0,0 +1,93 @@
+#include "httc/scan.hpp"
+#include <bit>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace httc {
+
+namespace {
+
+#if defined(__AVX2__)
+constexpr std::size_t BLOCK_SIZE = 32;
+
+// Bit i is set if p[i] == c
+std::uint32_t byte_mask(const char* p, char c) {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    auto eq = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+}
+#elif defined(__SSE2__)
+constexpr std::size_t BLOCK_SIZE = 16;
+
+// Bit i is set if p[i] == c
+std::uint32_t byte_mask(const char* p, char c) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto eq = _mm_cmpeq_epi8(block, _mm_set1_epi8(c));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+}
+#endif
+
+// Calls on_crlf(offset) for every CRLF at or after `from`, in order, until it returns false.
+// Returns the offset of the CRLF that stopped the scan, or npos.
+template<typename F>
+std::size_t scan_crlf(std::string_view data, std::size_t from, F&& on_crlf) {
+    const char* p = data.data();
+    const std::size_t n = data.size();
+    std::size_t i = from;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    // The LF mask is loaded one byte ahead, so a set bit in (CR & LF) marks a full CRLF,
+    // including pairs where the LF is the first byte of the next block.
+    for (; i + BLOCK_SIZE < n; i += BLOCK_SIZE) {
+        auto mask = byte_mask(p + i, '\r') & byte_mask(p + i + 1, '\n');
+        while (mask != 0) {
+            std::size_t pos = i + std::countr_zero(mask);
+            if (!on_crlf(pos)) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Scalar tail, or the whole input without SIMD support
+    for (; i + 1 < n; i++) {
+        if (p[i] == '\r' && p[i + 1] == '\n') {
+            if (!on_crlf(i)) {
+                return i;
+            }
+        }
+    }
+
+    return std::string_view::npos;
+}
+
+}
+
+std::size_t find_crlf(std::string_view data, std::size_t from) {
+    return scan_crlf(data, from, [](std::size_t) {
+        return false;
+    });
+}
+
+std::size_t
+    scan_header_lines(std::string_view data, std::size_t from, std::vector<std::size_t>& line_ends) {
+    auto end = scan_crlf(data, from, [&](std::size_t pos) {
+        // An empty line is a CRLF at the start of the block or right after the previous one
+        bool empty_line = line_ends.empty() ? pos == 0 : pos == line_ends.back() + 2;
+        line_ends.push_back(pos);
+        return !empty_line;
+    });
+
+    if (end == std::string_view::npos) {
+        return std::string_view::npos;
+    }
+    return end + 2;
+}
+
+}
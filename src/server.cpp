@@ -1,10 +1,23 @@
 #include "httc/server.hpp"
 #include <asio.hpp>
 #include <asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <optional>
 #include <print>
+#include <system_error>
+#include <thread>
 #include "httc/io.hpp"
 #include "httc/request_parser.hpp"
 #include "httc/response.hpp"
+#include "httc/response_queue.hpp"
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#endif
 
 namespace httc {
 
@@ -14,20 +27,223 @@ using asio::ip::tcp;
 
 using namespace asio::experimental::awaitable_operators;
 
-awaitable<void>
-    handle_conn(tcp::socket socket, std::shared_ptr<Router> router, const ServerConfig& cfg) {
-    SocketReader reader{ socket, cfg };
-    RequestParser req_parser{ cfg.max_header_size, cfg.max_body_size, reader };
+namespace {
+
+// Reads a streamed body for the handler and the server, under the request timeout like a body
+// that is read whole. Once the timer expires, reads fail as if the connection was closed
+template<typename P>
+class TimedBody {
+public:
+    TimedBody(P& parser, Request& req, asio::steady_timer& timer)
+    : m_parser(parser), m_timer(timer), m_reader(*this) {
+        // Binds `req`, which gets the trailers
+        parser.body_reader(req);
+    }
+
+    TimedBody(const TimedBody&) = delete;
+    TimedBody& operator=(const TimedBody&) = delete;
+
+    BodyReader& reader() {
+        return m_reader;
+    }
+
+    awaitable<std::expected<std::string_view, RequestParserError>> read_body_piece() {
+        if (m_timed_out) {
+            co_return std::unexpected(RequestParserError::READER_CLOSED);
+        }
+
+        auto result =
+            co_await (m_parser.read_body_piece() || m_timer.async_wait(asio::use_awaitable));
+        if (result.index() == 1) {
+            // The parser stopped in the middle of a read, so nothing more is read
+            m_timed_out = true;
+            co_return std::unexpected(RequestParserError::READER_CLOSED);
+        }
+        co_return std::get<0>(std::move(result));
+    }
+
+private:
+    P& m_parser;
+    asio::steady_timer& m_timer;
+    BodyReader m_reader;
+    bool m_timed_out = false;
+};
+
+// Reads what the handler left of a streamed body, to get to the next request. Returns false if
+// the connection closed or the request timed out first
+awaitable<bool> skip_body(BodyReader& reader) {
+    while (true) {
+        auto piece = co_await reader.read();
+        if (!piece.has_value()) {
+            co_return false;
+        }
+        if (piece->empty()) {
+            co_return true;
+        }
+    }
+}
+
+// Runs the handler of one request, with its response going into `slot`
+awaitable<void> handle_request(
+    RouterBase& router, const RouteMatch& route, Request& req,
+    std::shared_ptr<ResponseQueue> queue, std::shared_ptr<ResponseSlot> slot
+) {
+    auto writer = queue->writer(slot);
+
+    bool success = false;
+    try {
+        Response res{ writer };
+        co_await router.handle(route, req, res);
+        co_await res.send();
+        success = true;
+    } catch (std::exception& e) {
+        std::println("Error handling request: {}", e.what());
+    }
+
+    if (!success) {
+        auto res = Response::from_status(writer, StatusCode::INTERNAL_SERVER_ERROR);
+        co_await res.send();
+        slot->close = true;
+    }
+
+    slot->done = true;
+    queue->notify();
+}
+
+// Same as handle_request, but owns everything it uses so that it can outlive the connection
+awaitable<void> run_handler(
+    std::shared_ptr<RouterBase> router, RouteMatch route, Request req,
+    std::shared_ptr<ResponseQueue> queue, std::shared_ptr<ResponseSlot> slot
+) {
+    co_await handle_request(*router, route, req, std::move(queue), std::move(slot));
+}
+
+// Queues an error response after the responses of the earlier requests, and closes the
+// connection once it is written
+awaitable<void> fail_request(std::shared_ptr<ResponseQueue> queue, StatusCode status) {
+    auto slot = queue->push();
+    auto writer = queue->writer(slot);
+    auto res = Response::from_status(writer, status);
+    co_await res.send();
+
+    slot->done = true;
+    slot->close = true;
+    queue->notify();
+}
+
+// Parses the requests of a connection and starts their handlers without waiting for the earlier
+// ones to complete, with at most cfg.pipeline_window of them waiting for their response to be
+// written. Returns once the responses of every request are written
+awaitable<void> read_pipelined(
+    RequestParser<SocketReader>& req_parser, std::shared_ptr<RouterBase> router,
+    std::shared_ptr<ResponseQueue> queue, const ServerConfig& cfg
+) {
+    auto executor = co_await asio::this_coro::executor;
+    asio::steady_timer parse_request_timer(executor);
+
+    while (true) {
+        while (queue->size() >= cfg.pipeline_window) {
+            co_await queue->wait();
+        }
+
+        parse_request_timer.expires_after(cfg.request_timeout_seconds);
+        auto result = co_await (
+            req_parser.next_head() || parse_request_timer.async_wait(asio::use_awaitable)
+        );
+        if (result.index() == 1) {
+            // Request timeout
+            break;
+        }
 
+        auto req_opt = std::move(std::get<0>(result));
+        if (!req_opt.has_value()) {
+            // Connection closed
+            break;
+        }
+        if (!req_opt->has_value()) {
+            co_await fail_request(queue, parse_error_to_status_code(req_opt->error()));
+            break;
+        }
+
+        auto req = std::move(*req_opt).value();
+        auto route = router->find_route(req);
+        if (route.stream_body) {
+            // The body is read from the connection, so nothing else is parsed until the handler
+            // returns. The parser points to `req`, so it is handled in place
+            TimedBody body(req_parser, req, parse_request_timer);
+            req.body_reader = &body.reader();
+            co_await handle_request(*router, route, req, queue, queue->push());
+
+            if (!co_await skip_body(body.reader())) {
+                break;
+            }
+            continue;
+        }
+
+        // The request timeout also covers receiving the body
+        auto body_result = co_await (
+            req_parser.read_body(req) || parse_request_timer.async_wait(asio::use_awaitable)
+        );
+        if (body_result.index() == 1) {
+            break;
+        }
+
+        auto body_err = std::get<0>(body_result);
+        if (body_err == RequestParserError::READER_CLOSED) {
+            break;
+        } else if (body_err.has_value()) {
+            co_await fail_request(queue, parse_error_to_status_code(*body_err));
+            break;
+        }
+
+        // The handler owns everything it uses, so it can outlive the connection
+        asio::co_spawn(
+            executor, run_handler(router, std::move(route), std::move(req), queue, queue->push()),
+            asio::detached
+        );
+    }
+
+    queue->close();
+    while (queue->size() > 0) {
+        co_await queue->wait();
+    }
+}
+
+awaitable<void> handle_conn_pipelined(
+    tcp::socket socket, std::shared_ptr<RouterBase> router, const ServerConfig& cfg
+) {
+    SocketReader reader{ socket, cfg };
     SocketWriter writer{ socket };
+    RequestParser req_parser{
+        cfg.max_header_size, cfg.max_body_size, reader, cfg.input_buffer_size,
+        cfg.max_header_count
+    };
 
+    auto queue = std::make_shared<ResponseQueue>(
+        co_await asio::this_coro::executor, cfg.output_buffer_size
+    );
+
+    // Ends when every response is written, or when one of them closes the connection
+    co_await (read_pipelined(req_parser, router, queue, cfg) || queue->write_all(writer));
+    socket.close();
+}
+
+using ConnWriter = BatchingWriter<SocketWriter>;
+using ConnReader = FlushingReader<SocketReader, ConnWriter>;
+
+// Parses and handles the requests of a connection one at a time
+awaitable<void> read_requests(
+    tcp::socket& socket, RequestParser<ConnReader>& req_parser, ConnWriter& writer,
+    std::shared_ptr<RouterBase> router, const ServerConfig& cfg
+) {
     asio::steady_timer parse_request_timer(co_await asio::this_coro::executor);
 
     while (true) {
         parse_request_timer.expires_after(cfg.request_timeout_seconds);
 
-        auto result =
-            co_await (req_parser.next() || parse_request_timer.async_wait(asio::use_awaitable));
+        auto result = co_await (
+            req_parser.next_head() || parse_request_timer.async_wait(asio::use_awaitable)
+        );
         std::optional<std::expected<httc::Request, httc::RequestParserError>> req_opt;
         if (result.index() == 1) {
             // Request timeout
@@ -47,15 +263,44 @@ awaitable<void>
             auto res =
                 Response::from_status(writer, parse_error_to_status_code(req_result.error()));
             co_await res.send();
+            co_await writer.flush();
             socket.close();
             co_return;
         }
 
+        auto req = std::move(req_result).value();
+        auto route = router->find_route(req);
+        // Only bound to `req` for a streamed body, since the parser keeps pointing to it
+        std::optional<TimedBody<RequestParser<ConnReader>>> body;
+        if (route.stream_body) {
+            body.emplace(req_parser, req, parse_request_timer);
+            req.body_reader = &body->reader();
+        } else {
+            // The request timeout also covers receiving the body
+            auto body_result = co_await (
+                req_parser.read_body(req) || parse_request_timer.async_wait(asio::use_awaitable)
+            );
+            if (body_result.index() == 1) {
+                socket.shutdown(tcp::socket::shutdown_both);
+                co_return;
+            }
+
+            auto body_err = std::get<0>(body_result);
+            if (body_err == RequestParserError::READER_CLOSED) {
+                break;
+            } else if (body_err.has_value()) {
+                auto res = Response::from_status(writer, parse_error_to_status_code(*body_err));
+                co_await res.send();
+                co_await writer.flush();
+                socket.close();
+                co_return;
+            }
+        }
+
         bool success = false;
         try {
             Response res{ writer };
-            auto req = std::move(req_result).value();
-            co_await router->handle(req, res);
+            co_await router->handle(route, req, res);
             co_await res.send();
             success = true;
         } catch (std::exception& e) {
@@ -65,14 +310,97 @@ awaitable<void>
         if (!success) {
             auto res = Response::from_status(writer, StatusCode::INTERNAL_SERVER_ERROR);
             co_await res.send();
+            co_await writer.flush();
+            socket.close();
+            co_return;
+        }
+
+        if (body.has_value() && !co_await skip_body(body->reader())) {
+            co_await writer.flush();
             socket.close();
             co_return;
         }
     }
 }
 
+// Opens `acceptor` on `endpoint`. With SO_REUSEPORT, several acceptors can listen on the same port
+// and the kernel balances the new connections between them
+void open_acceptor(tcp::acceptor& acceptor, const tcp::endpoint& endpoint) {
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+#if defined(SO_REUSEPORT)
+    int enable = 1;
+    auto fd = acceptor.native_handle();
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0) {
+        throw std::system_error(errno, std::system_category(), "Error setting SO_REUSEPORT");
+    }
+#endif
+    acceptor.bind(endpoint);
+    acceptor.listen();
+}
+
+// Pins `thread` to the index-th CPU this process may run on, modulo their count. Failures are only
+// reported, since the worker runs fine unpinned
+void pin_to_cpu(std::thread& thread, std::size_t index) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        std::println(
+            "Error getting the CPUs to pin worker {} to: {}", index,
+            std::system_category().message(errno)
+        );
+        return;
+    }
+
+    // Holds at least the CPU this thread runs on
+    auto skip = index % static_cast<std::size_t>(CPU_COUNT(&allowed));
+    int cpu = 0;
+    for (; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && skip-- == 0) {
+            break;
+        }
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    auto err = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    if (err != 0) {
+        std::println(
+            "Error pinning worker {} to CPU {}: {}", index, cpu, std::system_category().message(err)
+        );
+    }
+#endif
+}
+
+}
+
+awaitable<void>
+    handle_conn(tcp::socket socket, std::shared_ptr<RouterBase> router, const ServerConfig& cfg) {
+    if (cfg.pipeline_window > 1) {
+        co_await handle_conn_pipelined(std::move(socket), router, cfg);
+        co_return;
+    }
+
+    // Responses are held back until the parser has to wait for more data, so the responses to
+    // pipelined requests that arrived together are sent with one write, in request order
+    SocketWriter socket_writer{ socket };
+    BatchingWriter writer{ socket_writer, cfg.output_buffer_size };
+    SocketReader socket_reader{ socket, cfg };
+    FlushingReader reader{ socket_reader, writer };
+
+    RequestParser req_parser{
+        cfg.max_header_size, cfg.max_body_size, reader, cfg.input_buffer_size,
+        cfg.max_header_count
+    };
+
+    // Held back output is also written whenever the handler waits on something else
+    co_await (read_requests(socket, req_parser, writer, router, cfg) || writer.flush_when_idle());
+}
+
 asio::awaitable<void>
-    listen(tcp::acceptor acceptor, std::shared_ptr<Router> router, const ServerConfig& config) {
+    listen(tcp::acceptor acceptor, std::shared_ptr<RouterBase> router, const ServerConfig& config) {
     for (;;) {
         try {
             auto socket = co_await acceptor.async_accept(use_awaitable);
@@ -85,7 +413,7 @@ asio::awaitable<void>
 }
 
 void bind_and_listen(
-    std::string_view addr, unsigned int port, std::shared_ptr<Router> router,
+    std::string_view addr, unsigned int port, std::shared_ptr<RouterBase> router,
     asio::io_context& io_ctx, const ServerConfig& config
 ) {
     tcp::endpoint endpoint(asio::ip::make_address(addr), port);
@@ -94,4 +422,61 @@ void bind_and_listen(
     asio::co_spawn(io_ctx, listen(std::move(acceptor), router, config), asio::detached);
 }
 
+Server::Server(
+    std::string_view addr, unsigned int port, std::shared_ptr<RouterBase> router,
+    const ServerConfig& config
+)
+: m_router(std::move(router)), m_config(config) {
+    auto threads = m_config.threads;
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+#if !defined(SO_REUSEPORT)
+    // Every worker needs its own acceptor on the port
+    threads = 1;
+#endif
+
+    tcp::endpoint endpoint(asio::ip::make_address(addr), port);
+    for (std::size_t i = 0; i < threads; i++) {
+        // Tells asio that a single thread runs it
+        auto io_ctx = std::make_unique<asio::io_context>(1);
+        tcp::acceptor acceptor(*io_ctx);
+        open_acceptor(acceptor, endpoint);
+        // The other workers bind to the port the first one got
+        endpoint = acceptor.local_endpoint();
+
+        asio::co_spawn(*io_ctx, listen(std::move(acceptor), m_router, m_config), asio::detached);
+        m_io_contexts.push_back(std::move(io_ctx));
+    }
+    m_port = endpoint.port();
+}
+
+void Server::run() {
+    std::vector<std::thread> threads;
+    threads.reserve(m_io_contexts.size());
+    for (std::size_t i = 0; i < m_io_contexts.size(); i++) {
+        threads.emplace_back([&io_ctx = *m_io_contexts[i]] {
+            io_ctx.run();
+        });
+        if (m_config.pin_threads) {
+            pin_to_cpu(threads.back(), i);
+        }
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // So that run() can be called again
+    for (auto& io_ctx : m_io_contexts) {
+        io_ctx->restart();
+    }
+}
+
+void Server::stop() {
+    for (auto& io_ctx : m_io_contexts) {
+        io_ctx->stop();
+    }
+}
+
 }
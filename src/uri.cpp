@@ -1,22 +1,50 @@
 #include "httc/uri.hpp"
+#include <algorithm>
 #include <optional>
-#include <print>
-#include <ranges>
 #include "httc/percent_encoding.hpp"
 
 namespace httc {
 
 std::optional<URI> URI::parse(std::string_view uri) {
     auto query_start = uri.find("?");
-    auto path = std::string(uri.substr(0, query_start));
-
-    std::vector<std::string> paths;
-    std::vector<std::pair<std::string, std::string>> query;
+    auto path = uri.substr(0, query_start);
 
     if (path.empty() || path[0] != '/') {
         return std::nullopt;
     }
 
+    URI result(uri);
+    if (query_start == std::string_view::npos) {
+        result.m_query_start = static_cast<std::uint32_t>(uri.size());
+    } else {
+        result.m_query_start = static_cast<std::uint32_t>(query_start + 1);
+        // Checked here, so decoding the query later cannot fail
+        if (!valid_percent_encoding(uri.substr(query_start + 1))) {
+            return std::nullopt;
+        }
+    }
+
+    // Decoding only shrinks a segment, so the decoded segments are packed from the start of the
+    // path without overwriting the bytes still to be read
+    bool valid = true;
+    std::size_t packed = 1;
+    auto add_segment = [&](std::size_t start, std::size_t end) {
+        if (!result.m_paths.empty()) {
+            result.m_buf[packed++] = '/';
+        }
+        auto size = percent_decode(
+            std::string_view(result.m_buf).substr(start, end - start), result.m_buf.data() + packed
+        );
+        if (!size.has_value()) {
+            valid = false;
+            return;
+        }
+        result.m_paths.push_back(
+            { static_cast<std::uint32_t>(packed), static_cast<std::uint32_t>(*size) }
+        );
+        packed += *size;
+    };
+
     size_t start = 1;
     size_t end = path.find("/", start);
     while (end != std::string::npos) {
@@ -27,81 +55,71 @@ std::optional<URI> URI::parse(std::string_view uri) {
                     return std::nullopt;
                 }
             }
-            paths.push_back(path.substr(start, end - start));
+            add_segment(start, end);
         }
         start = end + 1;
         end = path.find("/", start);
     }
-    paths.push_back(path.substr(start));
+    add_segment(start, path.size());
 
-    // Percent decode each path segment
-    for (auto& p : paths) {
-        auto decoded = percent_decode(p);
-        if (!decoded.has_value()) {
-            return std::nullopt;
-        }
-        p = *decoded;
+    if (!valid) {
+        return std::nullopt;
     }
+    return result;
+}
 
-    if (query_start == std::string::npos) {
-        return URI{ std::move(paths), std::move(query) };
-    }
+void URI::parse_query() const {
+    m_query_parsed = true;
 
-    std::string query_str = std::string(uri.substr(query_start + 1));
-    start = 0;
-    end = query_str.find("&", start);
-    while (end != std::string::npos) {
-        auto eq_pos = query_str.find("=", start);
+    auto decode = [&](std::size_t start, std::size_t end) {
+        // The encoding was validated by parse()
+        auto size = percent_decode_in_place(m_buf.data() + start, end - start);
+        return Slice{ static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(*size) };
+    };
+    auto add_param = [&](std::size_t start, std::size_t end) {
+        auto eq_pos = std::string_view(m_buf).find("=", start);
         if (eq_pos != std::string::npos && eq_pos < end) {
-            query.emplace_back(
-                query_str.substr(start, eq_pos - start),
-                query_str.substr(eq_pos + 1, end - eq_pos - 1)
-            );
+            m_query.push_back({ decode(start, eq_pos), decode(eq_pos + 1, end) });
         } else {
-            query.emplace_back(query_str.substr(start, end - start), "");
+            m_query.push_back({ decode(start, end), Slice{ 0, 0 } });
         }
+    };
+
+    std::string_view buf = m_buf;
+    size_t start = m_query_start;
+    size_t end = buf.find("&", start);
+    while (end != std::string::npos) {
+        add_param(start, end);
         start = end + 1;
-        end = query_str.find("&", start);
+        end = buf.find("&", start);
     }
-    if (start < query_str.size()) {
-        auto eq_pos = query_str.find("=", start);
-        if (eq_pos != std::string::npos) {
-            query.emplace_back(
-                query_str.substr(start, eq_pos - start), query_str.substr(eq_pos + 1)
-            );
-        } else {
-            query.emplace_back(query_str.substr(start), "");
-        }
-    }
-
-    // Percent decode each query key and value
-    for (auto& [key, value] : query) {
-        auto decoded_key = percent_decode(key);
-        if (!decoded_key.has_value()) {
-            return std::nullopt;
-        }
-        key = *decoded_key;
-
-        auto decoded_value = percent_decode(value);
-        if (!decoded_value.has_value()) {
-            return std::nullopt;
-        }
-        value = *decoded_value;
+    if (start < buf.size()) {
+        add_param(start, buf.size());
     }
+}
 
-    return URI{ std::move(paths), std::move(query) };
+URI::Paths URI::paths() const {
+    return Paths(&m_buf, m_paths.data(), m_paths.size());
 }
 
-const std::vector<std::string>& URI::paths() const {
-    return m_paths;
+std::string_view URI::path_from(std::size_t first) const {
+    if (first >= m_paths.size()) {
+        return {};
+    }
+    auto start = m_paths[first].offset;
+    auto end = m_paths.back().offset + m_paths.back().size;
+    return std::string_view(m_buf).substr(start, end - start);
 }
 
-const std::vector<std::pair<std::string, std::string>>& URI::query() const {
-    return m_query;
+URI::Query URI::query() const {
+    if (!m_query_parsed) {
+        parse_query();
+    }
+    return Query(&m_buf, m_query.data(), m_query.size());
 }
 
 std::optional<std::string_view> URI::query_param(std::string_view param) const {
-    for (const auto& [key, value] : m_query) {
+    for (auto [key, value] : query()) {
         if (key == param) {
             return value;
         }
@@ -112,7 +130,11 @@ std::optional<std::string_view> URI::query_param(std::string_view param) const {
 URIMatch URI::match(const URI& other) const {
     bool param_match[2] = { false, false };
 
-    for (const auto& [path_a, path_b] : std::views::zip(m_paths, other.m_paths)) {
+    auto paths_a = paths();
+    auto paths_b = other.paths();
+    for (std::size_t i = 0; i < std::min(paths_a.size(), paths_b.size()); i++) {
+        auto path_a = paths_a[i];
+        auto path_b = paths_b[i];
         if (path_a == "*" || path_b == "*") {
             return URIMatch::WILD_MATCH;
         }
@@ -134,11 +156,11 @@ URIMatch URI::match(const URI& other) const {
         }
     }
 
-    if (m_paths.size() != other.m_paths.size()) {
-        if (m_paths.size() == other.m_paths.size() + 1 && m_paths.back() == "*") {
+    if (paths_a.size() != paths_b.size()) {
+        if (paths_a.size() == paths_b.size() + 1 && paths_a.back() == "*") {
             return URIMatch::WILD_MATCH;
         }
-        if (other.m_paths.size() == m_paths.size() + 1 && other.m_paths.back() == "*") {
+        if (paths_b.size() == paths_a.size() + 1 && paths_b.back() == "*") {
             return URIMatch::WILD_MATCH;
         }
         return URIMatch::NO_MATCH;
@@ -158,8 +180,9 @@ std::string URI::to_string() const {
 
 std::string URI::path() const {
     std::string result;
-    for (const auto& p : m_paths) {
-        result += "/" + p;
+    for (auto p : paths()) {
+        result += "/";
+        result += p;
     }
     return result.empty() ? "/" : result;
 }
@@ -75,9 +75,9 @@ std::optional<std::filesystem::path>
 }
 
 std::string DirectoryHandler::generate_listing_html(
-    const std::string& url_path, const DirectoryListing& listing
+    std::string_view url_path, const DirectoryListing& listing
 ) const {
-    const auto index_of = m_base_dir.string() + "/" + url_path;
+    const auto index_of = std::format("{}/{}", m_base_dir.string(), url_path);
     std::string html = std::format("<html><head><title>Index of {}</title></head><body>", index_of);
     html += std::format("<h1>Index of {}</h1><hr><ul>", index_of);
 
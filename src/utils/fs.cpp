@@ -1,6 +1,5 @@
 #include "httc/utils/fs.hpp"
 #include <algorithm>
-#include <asio/redirect_error.hpp>
 #include <asio/stream_file.hpp>
 #include <asio/this_coro.hpp>
 #include <asio/use_awaitable.hpp>
@@ -78,21 +77,7 @@ asio::awaitable<void> serve_file(const std::filesystem::path& path, Response& re
     }
 
     auto stream = co_await res.send_fixed(size);
-
-    char buffer[8192];
-    while (true) {
-        std::size_t n = co_await file.async_read_some(
-            asio::buffer(buffer), asio::redirect_error(asio::use_awaitable, ec)
-        );
-
-        if (ec == asio::error::eof || n == 0) {
-            break;
-        } else if (ec) {
-            co_return;
-        }
-
-        co_await stream.write(std::string_view(buffer, n));
-    }
+    co_await stream.write_file(file, size);
 
     co_return;
 }
@@ -1,44 +1,166 @@
 #include "httc/validation.hpp"
+#include <array>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace httc {
 
-// https://www.rfc-editor.org/rfc/rfc9110#name-tokens
-bool valid_token(std::string_view str) {
-    if (str.empty()) {
-        return false;
+namespace {
+
+// Entry c is true if the byte c is allowed
+using ByteTable = std::array<bool, 256>;
+
+template<typename F>
+constexpr ByteTable make_table(F allowed) {
+    ByteTable table{};
+    for (std::size_t c = 0; c < table.size(); c++) {
+        table[c] = allowed(static_cast<unsigned char>(c));
     }
+    return table;
+}
+
+// https://www.rfc-editor.org/rfc/rfc9110#name-tokens
+constexpr ByteTable TOKEN_CHARS = make_table([](unsigned char c) {
+    return c == '!' || c == '#' || c == '$' || c == '%' || c == '&' || c == '\'' || c == '*'
+           || c == '+' || c == '-' || c == '.' || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z')
+           || c == '^' || c == '_' || c == '`' || (c >= 'a' && c <= 'z') || c == '|' || c == '~';
+});
+
+constexpr ByteTable COOKIE_VALUE_CHARS = make_table([](unsigned char c) {
+    return c == 0x21 || (c >= 0x23 && c <= 0x2B) || (c >= 0x2D && c <= 0x3A)
+           || (c >= 0x3C && c <= 0x5B) || (c >= 0x5D && c <= 0x7E);
+});
+
+constexpr ByteTable HEADER_VALUE_CHARS = make_table([](unsigned char c) {
+    return c == 0x09 || (c >= 0x20 && c <= 0x7E) || c >= 0x80;
+});
+
+bool all_in_table(std::string_view str, const ByteTable& table) {
     for (char c : str) {
-        if (c == '!' || c == '#' || c == '$' || c == '%' || c == '&' || c == '\'' || c == '*'
-            || c == '+' || c == '-' || c == '.' || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z')
-            || c == '^' || c == '_' || c == '`' || (c >= 'a' && c <= 'z') || c == '|' || c == '~') {
-            continue;
+        if (!table[static_cast<unsigned char>(c)]) {
+            return false;
         }
-        return false;
     }
     return true;
 }
 
-bool valid_cookie_value(std::string_view str) {
-    for (char c : str) {
-        unsigned char uc = static_cast<unsigned char>(c);
-        if (uc == 0x21 || (uc >= 0x23 && uc <= 0x2B) || (uc >= 0x2D && uc <= 0x3A)
-            || (uc >= 0x3C && uc <= 0x5B) || (uc >= 0x5D && uc <= 0x7E)) {
-            continue;
+#if defined(__AVX2__)
+using Block = __m256i;
+constexpr std::size_t BLOCK_SIZE = 32;
+
+Block load(const char* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const Block*>(p));
+}
+Block splat(unsigned char c) {
+    return _mm256_set1_epi8(static_cast<char>(c));
+}
+Block eq(Block a, Block b) {
+    return _mm256_cmpeq_epi8(a, b);
+}
+Block or_(Block a, Block b) {
+    return _mm256_or_si256(a, b);
+}
+// a & ~b
+Block and_not(Block a, Block b) {
+    return _mm256_andnot_si256(b, a);
+}
+// Unsigned a <= b for every byte
+Block le(Block a, Block b) {
+    return eq(_mm256_min_epu8(a, b), a);
+}
+// Unsigned a >= b for every byte
+Block ge(Block a, Block b) {
+    return eq(_mm256_max_epu8(a, b), a);
+}
+bool any(Block a) {
+    return _mm256_movemask_epi8(a) != 0;
+}
+#elif defined(__SSE2__)
+using Block = __m128i;
+constexpr std::size_t BLOCK_SIZE = 16;
+
+Block load(const char* p) {
+    return _mm_loadu_si128(reinterpret_cast<const Block*>(p));
+}
+Block splat(unsigned char c) {
+    return _mm_set1_epi8(static_cast<char>(c));
+}
+Block eq(Block a, Block b) {
+    return _mm_cmpeq_epi8(a, b);
+}
+Block or_(Block a, Block b) {
+    return _mm_or_si128(a, b);
+}
+// a & ~b
+Block and_not(Block a, Block b) {
+    return _mm_andnot_si128(b, a);
+}
+// Unsigned a <= b for every byte
+Block le(Block a, Block b) {
+    return eq(_mm_min_epu8(a, b), a);
+}
+// Unsigned a >= b for every byte
+Block ge(Block a, Block b) {
+    return eq(_mm_max_epu8(a, b), a);
+}
+bool any(Block a) {
+    return _mm_movemask_epi8(a) != 0;
+}
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+// Marks control characters other than HTAB, and DEL
+Block header_value_invalid(Block b) {
+    auto control = and_not(le(b, splat(0x1F)), eq(b, splat(0x09)));
+    return or_(control, eq(b, splat(0x7F)));
+}
+
+// Marks bytes outside 0x21-0x7E, and the DQUOTE, comma, semicolon and backslash inside it
+Block cookie_value_invalid(Block b) {
+    auto in_range = and_not(ge(b, splat(0x21)), ge(b, splat(0x7F)));
+    auto excluded = or_(
+        or_(eq(b, splat(0x22)), eq(b, splat(0x2C))), or_(eq(b, splat(0x3B)), eq(b, splat(0x5C)))
+    );
+    return or_(and_not(splat(0xFF), in_range), excluded);
+}
+
+// Returns the size of the leading whole blocks of `str` with no byte marked by `invalid`.
+// The rest is left to the table lookup
+template<typename F>
+std::size_t valid_blocks(std::string_view str, F invalid) {
+    std::size_t i = 0;
+    for (; i + BLOCK_SIZE <= str.size(); i += BLOCK_SIZE) {
+        if (any(invalid(load(str.data() + i)))) {
+            break;
         }
-        return false;
     }
-    return true;
+    return i;
+}
+#endif
+
+}
+
+bool valid_token(std::string_view str) {
+    return !str.empty() && all_in_table(str, TOKEN_CHARS);
+}
+
+bool valid_cookie_value(std::string_view str) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    str.remove_prefix(valid_blocks(str, cookie_value_invalid));
+#endif
+    return all_in_table(str, COOKIE_VALUE_CHARS);
 }
 
 bool valid_header_value(std::string_view str) {
-    for (char c : str) {
-        unsigned char uc = static_cast<unsigned char>(c);
-        if (uc == 0x09 || (uc >= 0x20 && uc <= 0x7E) || (uc >= 0x80 && uc <= 0xFF)) {
-            continue;
-        }
-        return false;
-    }
-    return true;
+#if defined(__AVX2__) || defined(__SSE2__)
+    str.remove_prefix(valid_blocks(str, header_value_invalid));
+#endif
+    return all_in_table(str, HEADER_VALUE_CHARS);
 }
 
 }
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <httc/header_names.hpp>
+#include <string>
+
+TEST_CASE("Find well-known headers") {
+    SECTION("Every name in any case") {
+        for (std::size_t i = 0; i < httc::HEADER_COUNT; i++) {
+            auto header = static_cast<httc::Header>(i);
+            std::string name(httc::header_name(header));
+            INFO(name);
+
+            REQUIRE(httc::find_header(name) == header);
+
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            REQUIRE(httc::find_header(name) == header);
+
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            REQUIRE(httc::find_header(name) == header);
+        }
+    }
+
+    SECTION("Canonical names") {
+        REQUIRE(httc::header_name(httc::Header::CONTENT_LENGTH) == "Content-Length");
+        REQUIRE(httc::header_name(httc::Header::WWW_AUTHENTICATE) == "WWW-Authenticate");
+    }
+
+    SECTION("Unknown names") {
+        REQUIRE(!httc::find_header("").has_value());
+        REQUIRE(!httc::find_header("X-Custom-Header").has_value());
+        REQUIRE(!httc::find_header("Content-Lengt").has_value());
+        REQUIRE(!httc::find_header("Content-Lengths").has_value());
+        // Differs from "Host" only in the lowercase bit of a non-letter
+        REQUIRE(!httc::find_header("Hos\x14").has_value());
+        REQUIRE(!httc::find_header("Content\rLength").has_value());
+    }
+}
+
+TEST_CASE("Header name hash") {
+    auto hash = httc::hash_header_name("X-Forwarded-For");
+    REQUIRE(httc::hash_header_name("x-forwarded-for") == hash);
+    REQUIRE(httc::hash_header_name("X-FORWARDED-FOR") == hash);
+    REQUIRE(httc::hash_header_name("X-Forwarded-Fo") != hash);
+    REQUIRE(httc::hash_header_name("X-Forwarded-Fox") != hash);
+    REQUIRE(httc::hash_header_name("") == httc::hash_header_name(""));
+
+    // Only letters are folded, not the other bytes that differ in the lowercase bit
+    REQUIRE(httc::hash_header_name("X-^") != httc::hash_header_name("X-~"));
+    REQUIRE(httc::hash_header_name("X-Custom-^") != httc::hash_header_name("X-Custom-~"));
+    REQUIRE(httc::hash_header_name("X-@[") != httc::hash_header_name("X-`{"));
+}
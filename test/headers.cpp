@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <catch2/catch_test_macros.hpp>
+#include <format>
 #include <httc/headers.hpp>
+#include <string>
 #include <vector>
 
 TEST_CASE("Headers case-insensitive lookup") {
@@ -60,3 +62,115 @@ TEST_CASE("Headers iterator interface") {
     REQUIRE(it != headers.end());
     REQUIRE(it->second == "value1");
 }
+
+TEST_CASE("Well-known headers") {
+    httc::Headers headers;
+    headers.add("content-length", "123");
+    headers.add_view("Host", "example.com");
+    headers.add("X-Custom-Header", "value1");
+
+    SECTION("Typed lookup") {
+        REQUIRE(headers.get_one(httc::Header::CONTENT_LENGTH) == "123");
+        REQUIRE(headers.get_one(httc::Header::HOST) == "example.com");
+        REQUIRE(!headers.get_one(httc::Header::CONTENT_TYPE).has_value());
+    }
+
+    SECTION("First value is kept") {
+        headers.add("Host", "other.com");
+        REQUIRE(headers.get_one(httc::Header::HOST) == "example.com");
+        REQUIRE(headers.get_one("HOST") == "example.com");
+    }
+
+    SECTION("Set replaces the value") {
+        headers.set("Content-Length", "456");
+        REQUIRE(headers.get_one(httc::Header::CONTENT_LENGTH) == "456");
+        REQUIRE(headers.size() == 3);
+    }
+
+    SECTION("Unset removes the value") {
+        REQUIRE(headers.unset("HOST"));
+        REQUIRE(!headers.get_one(httc::Header::HOST).has_value());
+        REQUIRE(!headers.get_one("Host").has_value());
+
+        headers.add("Host", "again.com");
+        REQUIRE(headers.get_one(httc::Header::HOST) == "again.com");
+    }
+}
+
+TEST_CASE("Headers keep insertion order") {
+    httc::Headers headers;
+    headers.add("Zeta", "1");
+    headers.add("Alpha", "2");
+    headers.add("zeta", "3");
+    headers.add("Host", "example.com");
+
+    auto names = [&] {
+        std::vector<std::string> names;
+        for (const auto& [name, value] : headers) {
+            names.push_back(std::string(name));
+        }
+        return names;
+    };
+
+    REQUIRE(names() == std::vector<std::string>{ "Zeta", "Alpha", "zeta", "Host" });
+
+    SECTION("Values of one name") {
+        auto [start, end] = headers.get("ZETA");
+        std::vector<std::string> values;
+        for (auto it = start; it != end; ++it) {
+            values.push_back(std::string(it->second));
+        }
+        REQUIRE(values == std::vector<std::string>{ "1", "3" });
+    }
+
+    SECTION("Unset keeps the order of the rest") {
+        REQUIRE(headers.unset("zeta"));
+        REQUIRE(names() == std::vector<std::string>{ "Alpha", "Host" });
+        REQUIRE(headers.get_one(httc::Header::HOST) == "example.com");
+        REQUIRE(!headers.unset("zeta"));
+    }
+
+    SECTION("Set appends the new entry") {
+        headers.set("Alpha", "4");
+        REQUIRE(names() == std::vector<std::string>{ "Zeta", "zeta", "Host", "Alpha" });
+        REQUIRE(headers.get_one("alpha") == "4");
+    }
+}
+
+TEST_CASE("Many headers") {
+    httc::Headers headers;
+    for (int i = 0; i < 100; i++) {
+        headers.add(std::format("X-Header-{}", i), std::to_string(i));
+    }
+    headers.add("x-header-7", "again");
+    headers.add("Content-Length", "5");
+
+    REQUIRE(headers.size() == 102);
+    REQUIRE(headers.get_one("X-HEADER-0") == "0");
+    REQUIRE(headers.get_one("x-header-99") == "99");
+    REQUIRE(headers.get_one(httc::Header::CONTENT_LENGTH) == "5");
+    REQUIRE(!headers.get_one("X-Header-100").has_value());
+
+    auto [start, end] = headers.get("X-Header-7");
+    REQUIRE(std::distance(start, end) == 2);
+
+    REQUIRE(headers.unset("X-Header-7"));
+    REQUIRE(headers.size() == 100);
+    REQUIRE(!headers.get_one("X-Header-7").has_value());
+    REQUIRE(headers.get_one("X-Header-8") == "8");
+    REQUIRE(headers.get_one("content-length") == "5");
+    REQUIRE(headers.begin()->first == "X-Header-0");
+
+    SECTION("Shrinking below the index threshold") {
+        for (int i = 10; i < 100; i++) {
+            headers.unset(std::format("X-Header-{}", i));
+        }
+        REQUIRE(headers.size() == 10);
+        REQUIRE(headers.get_one("x-header-9") == "9");
+        REQUIRE(headers.get_one(httc::Header::CONTENT_LENGTH) == "5");
+
+        headers.add("X-Header-9", "twice");
+        auto [first, last] = headers.get("X-Header-9");
+        REQUIRE(std::distance(first, last) == 2);
+    }
+}
@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+#include <httc/input_buffer.hpp>
+#include <string>
+
+TEST_CASE("Input buffer append and consume") {
+    httc::InputBuffer buffer(8);
+
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.append("abc") == 3);
+    REQUIRE(buffer.data() == "abc");
+
+    buffer.consume(1);
+    REQUIRE(buffer.data() == "bc");
+    REQUIRE(buffer.size() == 2);
+
+    SECTION("Stops at capacity") {
+        REQUIRE(buffer.append("defghijk") == 5);
+        REQUIRE(buffer.data() == "bcdefgh");
+    }
+
+    SECTION("Rewinds once everything is consumed") {
+        buffer.consume(2);
+        REQUIRE(buffer.empty());
+        REQUIRE(buffer.append("12345678") == 8);
+        REQUIRE(buffer.data() == "12345678");
+    }
+
+    SECTION("Full buffer") {
+        REQUIRE(buffer.append("defgh") == 5);
+        // The consumed byte at the front is reclaimed
+        REQUIRE(buffer.append("xy") == 1);
+        REQUIRE(buffer.data() == "bcdefghx");
+        REQUIRE(buffer.append("y") == 0);
+    }
+}
+
+TEST_CASE("Input buffer compaction") {
+    httc::InputBuffer buffer(8);
+
+    REQUIRE(buffer.append("abcdefgh") == 8);
+    buffer.consume(6);
+    REQUIRE(buffer.data() == "gh");
+
+    // Unread bytes move to the front to make room
+    REQUIRE(buffer.append("123456") == 6);
+    REQUIRE(buffer.data() == "gh123456");
+
+    buffer.consume(1);
+    // Not enough consumed space to be worth moving the unread bytes
+    REQUIRE(buffer.append("x") == 1);
+    REQUIRE(buffer.data() == "h123456x");
+
+    buffer.clear();
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.append(std::string(10, 'z')) == 8);
+}
+
+TEST_CASE("Input buffer storage") {
+    httc::InputBuffer buffer(64);
+    REQUIRE(!buffer.holds_storage());
+
+    REQUIRE(buffer.append("abc") == 3);
+    REQUIRE(buffer.holds_storage());
+    const char* storage = buffer.data().data();
+
+    // Unread bytes keep the storage
+    buffer.release();
+    REQUIRE(buffer.holds_storage());
+    REQUIRE(buffer.data() == "abc");
+
+    buffer.consume(3);
+    buffer.release();
+    REQUIRE(!buffer.holds_storage());
+    REQUIRE(buffer.empty());
+
+    // Taken again from the pool of this thread
+    REQUIRE(buffer.append("de") == 2);
+    REQUIRE(buffer.data() == "de");
+    REQUIRE(buffer.data().data() == storage);
+
+    httc::InputBuffer other(64);
+    REQUIRE(other.append("x") == 1);
+    REQUIRE(other.data().data() != storage);
+}
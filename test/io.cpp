@@ -0,0 +1,152 @@
+#include <asio/experimental/awaitable_operators.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <httc/io.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "async_test.hpp"
+
+using namespace asio::experimental::awaitable_operators;
+
+namespace {
+
+struct MockWriter {
+    std::vector<std::string> writes;
+
+    asio::awaitable<void> write(httc::WriteBuffers buffers) {
+        std::string current_write;
+        for (const auto& buf : buffers) {
+            current_write.append(static_cast<const char*>(buf.data()), buf.size());
+        }
+        writes.push_back(current_write);
+        co_return;
+    }
+};
+
+// Records the file regions it is asked to send among its writes
+struct MockFileWriter : MockWriter {
+    asio::awaitable<void> send_file(int fd, std::uint64_t offset, std::size_t size) {
+        writes.push_back(std::format("file {} {} {}", fd, offset, size));
+        co_return;
+    }
+};
+
+// Returns its pieces in order, recording how many writes had happened at each pull
+struct MockReader {
+    std::vector<std::string> pieces;
+    std::size_t index = 0;
+    MockWriter* writer = nullptr;
+    std::vector<std::size_t> writes_at_pull;
+
+    asio::awaitable<std::expected<std::string_view, httc::ReaderError>> pull() {
+        writes_at_pull.push_back(writer->writes.size());
+        if (index >= pieces.size()) {
+            co_return std::unexpected(httc::ReaderError::CLOSED);
+        }
+        co_return pieces[index++];
+    }
+};
+
+}
+
+TEST_CASE("Write buffers") {
+    httc::WriteBuffers buffers{ asio::buffer("b", 1), asio::buffer("c", 1) };
+    buffers.push_front(asio::buffer("a", 1));
+    buffers.push_back(asio::buffer("d", 1));
+    REQUIRE(buffers.size() == httc::WriteBuffers::MAX_BUFFERS);
+    REQUIRE(asio::buffer_size(buffers) == 4);
+
+    std::string joined;
+    for (const auto& buffer : buffers) {
+        joined.append(static_cast<const char*>(buffer.data()), buffer.size());
+    }
+    REQUIRE(joined == "abcd");
+
+    REQUIRE_THROWS_AS(buffers.push_back(asio::buffer("e", 1)), std::length_error);
+}
+
+ASYNC_TEST_CASE("Batching writer") {
+    MockWriter writer;
+    httc::BatchingWriter batching{ writer };
+
+    co_await batching.write({ asio::buffer("first ", 6) });
+    co_await batching.write({ asio::buffer("second", 6) });
+    REQUIRE(writer.writes.empty());
+    REQUIRE(batching.pending() == 12);
+
+    SECTION("Flush writes everything at once, in order") {
+        co_await batching.flush();
+        REQUIRE(writer.writes == std::vector<std::string>{ "first second" });
+        REQUIRE(batching.pending() == 0);
+
+        co_await batching.flush();
+        REQUIRE(writer.writes.size() == 1);
+    }
+
+    SECTION("Large writes are not held back") {
+        std::string large(128 * 1024, 'x');
+        co_await batching.write({ asio::buffer(large) });
+        REQUIRE(writer.writes.size() == 1);
+        REQUIRE(writer.writes[0] == "first second" + large);
+        REQUIRE(batching.pending() == 0);
+    }
+}
+
+ASYNC_TEST_CASE("Batching writer sends files") {
+    static_assert(httc::FileWriter<httc::BatchingWriter<MockFileWriter>>);
+    static_assert(!httc::FileWriter<httc::BatchingWriter<MockWriter>>);
+
+    MockFileWriter writer;
+    httc::BatchingWriter batching{ writer };
+
+    co_await batching.write({ asio::buffer("head", 4) });
+    co_await batching.send_file(3, 10, 100);
+    REQUIRE(writer.writes == std::vector<std::string>{ "head", "file 3 10 100" });
+    REQUIRE(batching.pending() == 0);
+}
+
+ASYNC_TEST_CASE("Batching writer flushes when idle") {
+    MockWriter writer;
+    httc::BatchingWriter batching{ writer };
+
+    auto handler = [&]() -> asio::awaitable<void> {
+        co_await batching.write({ asio::buffer("first ", 6) });
+        co_await batching.write({ asio::buffer("second", 6) });
+        REQUIRE(writer.writes.empty());
+
+        // Waiting on anything lets the held back data go out, in one write
+        asio::steady_timer timer(co_await asio::this_coro::executor, std::chrono::milliseconds(1));
+        co_await timer.async_wait(asio::use_awaitable);
+        REQUIRE(writer.writes == std::vector<std::string>{ "first second" });
+        REQUIRE(batching.pending() == 0);
+
+        co_await batching.write({ asio::buffer("third", 5) });
+        co_await batching.flush();
+        REQUIRE(writer.writes == std::vector<std::string>{ "first second", "third" });
+    };
+    co_await (handler() || batching.flush_when_idle());
+}
+
+ASYNC_TEST_CASE("Flushing reader") {
+    MockWriter writer;
+    httc::BatchingWriter batching{ writer };
+    MockReader source{ { "abc" }, 0, &writer };
+    httc::FlushingReader reader{ source, batching };
+
+    co_await batching.write({ asio::buffer("response", 8) });
+    auto piece = co_await reader.pull();
+    REQUIRE(piece.has_value());
+    REQUIRE(*piece == "abc");
+
+    // Flushed before reading
+    REQUIRE(source.writes_at_pull == std::vector<std::size_t>{ 1 });
+    REQUIRE(writer.writes == std::vector<std::string>{ "response" });
+
+    // Nothing held back, nothing written
+    auto closed = co_await reader.pull();
+    REQUIRE(!closed.has_value());
+    REQUIRE(writer.writes.size() == 1);
+}
@@ -0,0 +1,43 @@
+#include <catch2/catch_test_macros.hpp>
+#include <httc/method.hpp>
+#include <string_view>
+
+TEST_CASE("Method constexpr", "[method]") {
+    static_assert(httc::Method::find("GET") == httc::Method::GET);
+    static_assert(httc::Method::find("OPTIONS") == httc::Method::OPTIONS);
+    static_assert(!httc::Method::find("get").has_value());
+    static_assert(!httc::Method::find("").has_value());
+
+    constexpr httc::MethodSet set = { httc::Method::GET, httc::Method::POST };
+    static_assert(set.contains(httc::Method::POST));
+    static_assert(!set.contains(httc::Method::PUT));
+    static_assert(!set.contains(httc::Method::OTHER));
+}
+
+TEST_CASE("Method tokens", "[method]") {
+    SECTION("Standard methods") {
+        for (std::size_t i = 0; i < httc::Method::COUNT; i++) {
+            auto id = static_cast<httc::Method::Id>(i);
+            httc::Method method(httc::Method::name(id));
+            REQUIRE(method.id() == id);
+            REQUIRE(method.name() == httc::Method::name(id));
+        }
+    }
+
+    SECTION("Other tokens") {
+        httc::Method method("PROPFIND");
+        REQUIRE(method.id() == httc::Method::OTHER);
+        REQUIRE(method.name() == "PROPFIND");
+        REQUIRE(method == "PROPFIND");
+        REQUIRE(method != "MKCOL");
+        REQUIRE(method != httc::Method::GET);
+    }
+
+    SECTION("Near misses") {
+        REQUIRE(httc::Method("GETS").id() == httc::Method::OTHER);
+        REQUIRE(httc::Method("GE").id() == httc::Method::OTHER);
+        REQUIRE(httc::Method("Get").id() == httc::Method::OTHER);
+        REQUIRE(httc::Method(std::string_view("GET\0", 4)).id() == httc::Method::OTHER);
+        REQUIRE(httc::Method("OPTIONSX").id() == httc::Method::OTHER);
+    }
+}
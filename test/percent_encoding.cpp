@@ -1,5 +1,9 @@
 #include <catch2/catch_test_macros.hpp>
+#include <cctype>
+#include <format>
 #include <httc/percent_encoding.hpp>
+#include <string>
+#include <string_view>
 
 TEST_CASE("Percent decode valid sequences") {
     SECTION("Basic percent decoding") {
@@ -191,3 +195,78 @@ TEST_CASE("Percent encode/decode roundtrip") {
         REQUIRE(*decoded == original);
     }
 }
+
+TEST_CASE("Percent decode into a buffer") {
+    SECTION("In place") {
+        std::string str = "a%20b%2Fc";
+        auto size = httc::percent_decode_in_place(str.data(), str.size());
+        REQUIRE(size.has_value());
+        REQUIRE(std::string_view(str.data(), *size) == "a b/c");
+    }
+
+    SECTION("Invalid in place") {
+        std::string str = "a%2";
+        REQUIRE(!httc::percent_decode_in_place(str.data(), str.size()).has_value());
+    }
+
+    SECTION("Long runs around escapes") {
+        // Longer than a SIMD block, with escapes at block boundaries and in the scalar tail
+        std::string plain(100, 'x');
+        for (std::size_t pos : { 0, 15, 16, 31, 32, 63, 97 }) {
+            std::string encoded = plain;
+            encoded.replace(pos, 1, "%41");
+            std::string expected = plain;
+            expected[pos] = 'A';
+
+            auto decoded = httc::percent_decode(encoded);
+            REQUIRE(decoded.has_value());
+            REQUIRE(*decoded == expected);
+
+            auto size = httc::percent_decode_in_place(encoded.data(), encoded.size());
+            REQUIRE(size.has_value());
+            REQUIRE(std::string_view(encoded.data(), *size) == expected);
+        }
+    }
+
+    SECTION("Invalid escape after a long run") {
+        std::string encoded(70, 'x');
+        encoded += "%4";
+        REQUIRE(!httc::percent_decode(encoded).has_value());
+        REQUIRE(!httc::valid_percent_encoding(encoded));
+    }
+}
+
+TEST_CASE("Percent encode into a buffer") {
+    SECTION("Encoded size") {
+        REQUIRE(httc::percent_encoded_size("") == 0);
+        REQUIRE(httc::percent_encoded_size("abc") == 3);
+        REQUIRE(httc::percent_encoded_size("a b/c") == 9);
+    }
+
+    SECTION("Into a buffer") {
+        std::string_view str = "a b/c";
+        std::string out(httc::percent_encoded_size(str), '\0');
+        auto end = httc::percent_encode(str, out.data());
+        REQUIRE(end == out.data() + out.size());
+        REQUIRE(out == "a%20b%2Fc");
+    }
+
+    SECTION("Every byte value") {
+        // Reserved bytes at every position of a SIMD block
+        std::string str;
+        for (int i = 0; i < 256; i++) {
+            str += static_cast<char>(i);
+            str += "abcdefghijklmnopqrstuvwxyz0123456789-._~"[i % 40];
+        }
+
+        std::string expected;
+        for (unsigned char c : str) {
+            bool unreserved = std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~';
+            expected += unreserved ? std::string(1, c) : std::format("%{:02X}", c);
+        }
+
+        auto encoded = httc::percent_encode(str);
+        REQUIRE(encoded == expected);
+        REQUIRE(httc::percent_decode(encoded) == str);
+    }
+}
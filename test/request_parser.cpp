@@ -1,5 +1,6 @@
 #include <catch2/catch_message.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <cstring>
 #include <httc/io.hpp>
 #include <httc/request_parser.hpp>
 #include "async_test.hpp"
@@ -71,6 +72,58 @@ private:
     std::size_t index = 0;
 };
 
+// Like StringArrayReader, but copies into the parser's storage when it can
+class StringArrayDirectReader {
+public:
+    asio::awaitable<std::expected<std::string_view, httc::ReaderError>> pull() {
+        if (index >= data.size()) {
+            co_return std::unexpected(httc::ReaderError::CLOSED);
+        }
+        auto piece = std::string_view(data[index]).substr(offset);
+        index++;
+        offset = 0;
+        co_return piece;
+    };
+
+    asio::awaitable<std::expected<std::size_t, httc::ReaderError>>
+        pull_into(std::span<char> buffer) {
+        if (index >= data.size()) {
+            co_return std::unexpected(httc::ReaderError::CLOSED);
+        }
+        auto piece = std::string_view(data[index]).substr(offset);
+        auto n = std::min(piece.size(), buffer.size());
+        std::memcpy(buffer.data(), piece.data(), n);
+        offset += n;
+        if (offset == data[index].size()) {
+            index++;
+            offset = 0;
+        }
+        co_return n;
+    };
+
+    void set_data(const std::vector<std::string>& input_data) {
+        data = input_data;
+        index = 0;
+        offset = 0;
+    }
+
+private:
+    std::vector<std::string> data;
+    std::size_t index = 0;
+    std::size_t offset = 0;
+};
+
+// A StringArrayDirectReader that can wait for data
+class WaitingStringArrayReader : public StringArrayDirectReader {
+public:
+    asio::awaitable<std::expected<void, httc::ReaderError>> wait() {
+        waits++;
+        co_return std::expected<void, httc::ReaderError>{};
+    }
+
+    int waits = 0;
+};
+
 ASYNC_TEST_CASE("Parse request line") {
     auto reader = StringReader{};
     httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader };
@@ -584,6 +637,323 @@ ASYNC_TEST_CASE("Multiple requests") {
     REQUIRE(req2.body == "Hello, World!");
 }
 
+ASYNC_TEST_CASE("Wait for data with an empty input buffer") {
+    WaitingStringArrayReader reader;
+    static_assert(httc::WaitingReader<WaitingStringArrayReader>);
+    httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader };
+
+    reader.set_data({ "GET /a HTTP/1.1\r\n\r\n", "GET /b HTTP/1.1\r\nHost: x", "\r\n\r\n" });
+
+    auto result1 = co_await parser.next();
+    REQUIRE(result1.has_value());
+    REQUIRE(result1->has_value());
+    REQUIRE(result1->value().uri.to_string() == "/a");
+    REQUIRE(reader.waits == 1);
+
+    // Waits before the first piece of /b, but not while part of its header is left unparsed
+    auto result2 = co_await parser.next();
+    REQUIRE(result2.has_value());
+    REQUIRE(result2->has_value());
+    REQUIRE(result2->value().uri.to_string() == "/b");
+    REQUIRE(reader.waits == 2);
+}
+
+// Parses `data` followed by a pipelined "GET /next" request with a 1KB input buffer
+template<typename ReaderT>
+asio::awaitable<void> check_large_body(std::vector<std::string> data, const std::string& body) {
+    ReaderT reader;
+    reader.set_data(data);
+    httc::RequestParser parser{ 1024, MAX_BODY_SIZE, reader, 1024 };
+
+    auto result1 = co_await parser.next();
+    REQUIRE(result1.has_value());
+    REQUIRE(result1->has_value());
+    REQUIRE(result1->value().body == body);
+
+    auto result2 = co_await parser.next();
+    REQUIRE(result2.has_value());
+    REQUIRE(result2->has_value());
+    REQUIRE(result2->value().uri.to_string() == "/next");
+}
+
+ASYNC_TEST_CASE("Bodies larger than the input buffer") {
+    std::string body(10000, 'b');
+
+    std::vector<std::string> content_length = {
+        "POST /upload HTTP/1.1\r\n"
+        "Content-Length: 10000\r\n"
+        "\r\n"
+            + body.substr(0, 300),
+        body.substr(300, 5000),
+        body.substr(5300) + "GET /next HTTP/1.1\r\n\r\n",
+    };
+    std::vector<std::string> chunked = {
+        "POST /upload HTTP/1.1\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "2710\r\n"
+            + body.substr(0, 4000),
+        body.substr(4000) + "\r\n0\r\n\r\nGET /next HTTP/1.1\r\n\r\n",
+    };
+
+    SECTION("Content-Length body") {
+        co_await check_large_body<StringArrayReader>(content_length, body);
+    }
+
+    SECTION("Chunked body") {
+        co_await check_large_body<StringArrayReader>(chunked, body);
+    }
+
+    SECTION("Content-Length body read in place") {
+        co_await check_large_body<StringArrayDirectReader>(content_length, body);
+    }
+
+    SECTION("Chunked body read in place") {
+        co_await check_large_body<StringArrayDirectReader>(chunked, body);
+    }
+}
+
+// Streams the body of the first request in `data`, followed by a pipelined "GET /next" request
+template<typename ReaderT>
+asio::awaitable<void> check_streamed_body(std::vector<std::string> data, const std::string& body) {
+    ReaderT reader;
+    reader.set_data(data);
+    httc::RequestParser parser{ 1024, MAX_BODY_SIZE, reader, 1024 };
+
+    auto result1 = co_await parser.next_head();
+    REQUIRE(result1.has_value());
+    REQUIRE(result1->has_value());
+    auto& req1 = result1->value();
+    REQUIRE(req1.uri.to_string() == "/upload");
+
+    auto body_reader = parser.body_reader(req1);
+    std::string streamed;
+    while (true) {
+        auto piece = co_await body_reader.read();
+        REQUIRE(piece.has_value());
+        if (piece->empty()) {
+            break;
+        }
+        streamed += *piece;
+    }
+    REQUIRE(streamed == body);
+    REQUIRE(req1.body.empty());
+
+    // Reading past the end keeps returning the end of the body
+    auto end = co_await body_reader.read();
+    REQUIRE(end.has_value());
+    REQUIRE(end->empty());
+
+    auto result2 = co_await parser.next_head();
+    REQUIRE(result2.has_value());
+    REQUIRE(result2->has_value());
+    REQUIRE(result2->value().uri.to_string() == "/next");
+}
+
+ASYNC_TEST_CASE("Streamed bodies") {
+    std::string body(3000, 'b');
+
+    std::vector<std::string> content_length = {
+        "POST /upload HTTP/1.1\r\n"
+        "Content-Length: 3000\r\n"
+        "\r\n"
+            + body.substr(0, 300),
+        body.substr(300, 2000),
+        body.substr(2300) + "GET /next HTTP/1.1\r\n\r\n",
+    };
+    std::vector<std::string> chunked = {
+        "POST /upload HTTP/1.1\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "3E8\r\n"
+            + body.substr(0, 500),
+        body.substr(500, 500) + "\r\n7D0\r\n" + body.substr(1000, 1500),
+        body.substr(2500) + "\r\n0\r\n\r\nGET /next HTTP/1.1\r\n\r\n",
+    };
+
+    SECTION("Content-Length body") {
+        co_await check_streamed_body<StringArrayReader>(content_length, body);
+    }
+
+    SECTION("Chunked body") {
+        co_await check_streamed_body<StringArrayReader>(chunked, body);
+    }
+
+    SECTION("Content-Length body read in place") {
+        co_await check_streamed_body<StringArrayDirectReader>(content_length, body);
+    }
+
+    SECTION("Chunked body read in place") {
+        co_await check_streamed_body<StringArrayDirectReader>(chunked, body);
+    }
+
+    SECTION("Trailers") {
+        StringArrayReader reader;
+        reader.set_data(
+            { "POST /upload HTTP/1.1\r\n"
+              "Transfer-Encoding: chunked\r\n"
+              "\r\n"
+              "5\r\nHello\r\n0\r\n"
+              "Checksum: abc\r\n"
+              "\r\n" }
+        );
+        httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader };
+
+        auto result = co_await parser.next_head();
+        REQUIRE(result.has_value());
+        REQUIRE(result->has_value());
+        auto& req = result->value();
+
+        auto body_reader = parser.body_reader(req);
+        auto piece = co_await body_reader.read();
+        REQUIRE(piece.has_value());
+        REQUIRE(*piece == "Hello");
+        REQUIRE(req.trailers.size() == 0);
+
+        auto end = co_await body_reader.read();
+        REQUIRE(end.has_value());
+        REQUIRE(end->empty());
+        REQUIRE(req.trailers.get_one("Checksum") == "abc");
+    }
+
+    SECTION("Chunked body exceeding maximum size") {
+        StringArrayReader reader;
+        reader.set_data(
+            { "POST /upload HTTP/1.1\r\n"
+              "Transfer-Encoding: chunked\r\n"
+              "\r\n"
+              "A\r\n0123456789\r\n"
+              "A\r\n0123456789\r\n" }
+        );
+        httc::RequestParser parser{ MAX_HEADER_SIZE, 15, reader };
+
+        auto result = co_await parser.next_head();
+        REQUIRE(result.has_value());
+        REQUIRE(result->has_value());
+
+        auto body_reader = parser.body_reader(result->value());
+        auto piece = co_await body_reader.read();
+        REQUIRE(piece.has_value());
+        REQUIRE(*piece == "0123456789");
+
+        auto err = co_await body_reader.read();
+        REQUIRE(!err.has_value());
+        REQUIRE(err.error() == httc::RequestParserError::CONTENT_TOO_LARGE);
+    }
+
+    SECTION("Request without body") {
+        StringReader reader;
+        reader.set_data("GET /index.html HTTP/1.1\r\n\r\n");
+        httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader };
+
+        auto result = co_await parser.next_head();
+        REQUIRE(result.has_value());
+        REQUIRE(result->has_value());
+
+        auto body_reader = parser.body_reader(result->value());
+        auto end = co_await body_reader.read();
+        REQUIRE(end.has_value());
+        REQUIRE(end->empty());
+    }
+}
+
+TEST_CASE("Parse without a reader") {
+    StringReader reader;
+    httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader };
+
+    SECTION("Pipelined requests") {
+        std::string data = "POST /a HTTP/1.1\r\n"
+                           "Content-Length: 5\r\n"
+                           "\r\n"
+                           "Hello"
+                           "GET /b HTTP/1.1\r\n"
+                           "\r\n"
+                           "GET /c HT";
+
+        REQUIRE(parser.feed(data) == httc::ParseStatus::REQUEST_READY);
+        auto req1 = parser.take_request();
+        REQUIRE(req1.uri.to_string() == "/a");
+        REQUIRE(req1.body == "Hello");
+
+        REQUIRE(parser.feed({}) == httc::ParseStatus::REQUEST_READY);
+        auto req2 = parser.take_request();
+        REQUIRE(req2.uri.to_string() == "/b");
+
+        REQUIRE(parser.feed({}) == httc::ParseStatus::NEED_MORE);
+        REQUIRE(parser.feed("TP/1.1\r\n\r\n") == httc::ParseStatus::REQUEST_READY);
+        auto req3 = parser.take_request();
+        REQUIRE(req3.uri.to_string() == "/c");
+    }
+
+    SECTION("Pipelined request after a body larger than the input buffer") {
+        // The body is taken from the fed data, after the start of it filled the input buffer
+        httc::RequestParser small_parser{ 64, MAX_BODY_SIZE, reader, 64 };
+        std::string body(100, 'x');
+        std::string data = "POST /a HTTP/1.1\r\n"
+                           "Content-Length: 100\r\n"
+                           "\r\n"
+                           + body
+                           + "GET /b HTTP/1.1\r\n"
+                             "\r\n";
+
+        REQUIRE(small_parser.feed(data) == httc::ParseStatus::REQUEST_READY);
+        auto req1 = small_parser.take_request();
+        REQUIRE(req1.uri.to_string() == "/a");
+        REQUIRE(req1.body == body);
+
+        REQUIRE(small_parser.feed({}) == httc::ParseStatus::REQUEST_READY);
+        auto req2 = small_parser.take_request();
+        REQUIRE(req2.uri.to_string() == "/b");
+        REQUIRE(small_parser.feed({}) == httc::ParseStatus::NEED_MORE);
+    }
+
+    SECTION("More data fed before the earlier data is parsed") {
+        httc::RequestParser small_parser{ 64, MAX_BODY_SIZE, reader, 64 };
+        std::string data = "POST /a HTTP/1.1\r\n"
+                           "Content-Length: 100\r\n"
+                           "\r\n"
+                           + std::string(100, 'x')
+                           + "GET /b HT";
+
+        REQUIRE(small_parser.feed(data) == httc::ParseStatus::REQUEST_READY);
+        small_parser.take_request();
+        REQUIRE(small_parser.feed("TP/1.1\r\n\r\n") == httc::ParseStatus::REQUEST_READY);
+        REQUIRE(small_parser.take_request().uri.to_string() == "/b");
+    }
+
+    SECTION("Body split across feeds") {
+        REQUIRE(
+            parser.feed("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nHel")
+            == httc::ParseStatus::NEED_MORE
+        );
+        REQUIRE(parser.feed("lo\r") == httc::ParseStatus::NEED_MORE);
+        REQUIRE(parser.feed("\n0\r\n\r\n") == httc::ParseStatus::REQUEST_READY);
+        REQUIRE(parser.take_request().body == "Hello");
+    }
+
+    SECTION("Invalid request") {
+        REQUIRE(parser.feed("GET /a HTTP/1.0\r\n\r\n") == httc::ParseStatus::ERROR);
+        REQUIRE(parser.error() == httc::RequestParserError::INVALID_REQUEST_LINE);
+
+        // The parser starts over after an error
+        REQUIRE(parser.feed("GET /a HTTP/1.1\r\n\r\n") == httc::ParseStatus::REQUEST_READY);
+    }
+}
+
+TEST_CASE("Request URI is moved out of the parsed URI") {
+    // Past the small string size, so the URI buffer is allocated once when it is parsed. The
+    // parser moves it into the request the same way
+    std::string_view target = "/api/v1/users/123";
+    auto uri = httc::URI::parse(target);
+    REQUIRE(uri.has_value());
+    auto data = uri->paths()[0].data();
+
+    httc::Request req;
+    req.uri = std::move(*uri);
+    REQUIRE(req.uri.paths()[0].data() == data);
+    REQUIRE(req.uri.to_string() == target);
+}
+
 ASYNC_TEST_CASE("URI with encoded reserved characters") {
     StringReader reader;
     httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader };
@@ -640,6 +1010,38 @@ ASYNC_TEST_CASE("Many small headers exceeding limit") {
     REQUIRE(result->error() == httc::RequestParserError::HEADER_TOO_LARGE);
 }
 
+ASYNC_TEST_CASE("Header count limit") {
+    StringReader reader;
+    httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader, MAX_HEADER_SIZE, 3 };
+
+    SECTION("At the limit") {
+        reader.set_data("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n");
+        auto result = co_await parser.next();
+        REQUIRE(result.has_value());
+        REQUIRE(result->has_value());
+        REQUIRE(result->value().headers.size() == 3);
+    }
+
+    SECTION("Over the limit") {
+        reader.set_data("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\nD: 4\r\n\r\n");
+        auto result = co_await parser.next();
+        REQUIRE(result.has_value());
+        REQUIRE(!result->has_value());
+        REQUIRE(result->error() == httc::RequestParserError::TOO_MANY_HEADERS);
+    }
+
+    SECTION("Trailers over the limit") {
+        reader.set_data(
+            "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "0\r\nA: 1\r\nB: 2\r\nC: 3\r\nD: 4\r\n\r\n"
+        );
+        auto result = co_await parser.next();
+        REQUIRE(result.has_value());
+        REQUIRE(!result->has_value());
+        REQUIRE(result->error() == httc::RequestParserError::TOO_MANY_HEADERS);
+    }
+}
+
 ASYNC_TEST_CASE("Cookies") {
     StringReader reader;
     httc::RequestParser parser{ MAX_HEADER_SIZE, MAX_BODY_SIZE, reader };
@@ -695,4 +1097,60 @@ ASYNC_TEST_CASE("Cookies") {
         REQUIRE(cookies.at("theme") == "light");
         REQUIRE(cookies.at("lang") == "en");
     }
+
+    SECTION("Invalid cookie separators") {
+        reader.set_data(
+            "GET / HTTP/1.1\r\n"
+            "Cookie: sessionId=abc123;\x01theme=light\r\n"
+            "\r\n"
+        );
+        auto result = co_await parser.next();
+        REQUIRE(result.has_value());
+        REQUIRE(!result->has_value());
+        REQUIRE(result->error() == httc::RequestParserError::INVALID_HEADER);
+
+        reader.set_data(
+            "GET / HTTP/1.1\r\n"
+            "Cookie: sessionId=abc123;\r\n"
+            "\r\n"
+        );
+        result = co_await parser.next();
+        REQUIRE(result.has_value());
+        REQUIRE(!result->has_value());
+        REQUIRE(result->error() == httc::RequestParserError::INVALID_HEADER);
+    }
+
+    SECTION("Keep-alive requests with cookies") {
+        reader.set_data(
+            "GET /a HTTP/1.1\r\n"
+            "Cookie: first=1\r\n"
+            "\r\n"
+            "POST /b HTTP/1.1\r\n"
+            "Cookie: second=2\r\n"
+            "Content-Length: 5\r\n"
+            "\r\n"
+            "Hello"
+        );
+
+        // The first request has no body, and is gone before the next one is parsed
+        {
+            auto result = co_await parser.next_head();
+            REQUIRE(result.has_value());
+            REQUIRE(result->has_value());
+            auto req = std::move(result->value());
+            auto body_reader = parser.body_reader(req);
+            REQUIRE(!(co_await parser.read_body(req)).has_value());
+            REQUIRE(req.cookies.size() == 1);
+            REQUIRE(req.cookies.at("first") == "1");
+        }
+
+        auto result = co_await parser.next_head();
+        REQUIRE(result.has_value());
+        REQUIRE(result->has_value());
+        auto& req = result->value();
+        REQUIRE(!(co_await parser.read_body(req)).has_value());
+        REQUIRE(req.body == "Hello");
+        REQUIRE(req.cookies.size() == 1);
+        REQUIRE(req.cookies.at("second") == "2");
+    }
 }
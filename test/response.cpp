@@ -11,7 +11,7 @@ struct MockWriter {
     std::string output;
     std::vector<std::string> writes;
 
-    asio::awaitable<void> write(std::vector<asio::const_buffer> buffers) {
+    asio::awaitable<void> write(httc::WriteBuffers buffers) {
         std::string current_write;
         for (const auto& buf : buffers) {
             std::string_view part(static_cast<const char*>(buf.data()), buf.size());
@@ -147,3 +147,53 @@ ASYNC_TEST_CASE("Response - Cookies with various body types") {
         co_await stream.write("Fixed");
     }
 }
+
+ASYNC_TEST_CASE("Response - Batching writer") {
+    MockWriter writer;
+    BatchingWriter batching{ writer };
+
+    SECTION("Complete responses are held back") {
+        Response first(batching);
+        first.set_body("one");
+        co_await first.send();
+
+        Response second(batching);
+        second.set_body("two");
+        co_await second.send();
+
+        REQUIRE(writer.writes.empty());
+
+        co_await batching.flush();
+        REQUIRE(writer.writes.size() == 1);
+        REQUIRE(writer.output.find("one") < writer.output.find("two"));
+    }
+
+    SECTION("Streamed writes are held back until flushed") {
+        Response res(batching);
+        auto stream = co_await res.send_chunked();
+        co_await stream.write("Wiki");
+        co_await stream.write("pedia");
+        REQUIRE(writer.writes.empty());
+
+        co_await stream.flush();
+        REQUIRE(writer.writes.size() == 1);
+        REQUIRE(writer.writes[0].ends_with("4\r\nWiki\r\n5\r\npedia\r\n"));
+
+        co_await stream.end();
+        REQUIRE(batching.pending() == 5);
+    }
+
+    SECTION("Streamed writes are written past the buffer size") {
+        BatchingWriter small{ writer, 16 };
+        Response res(small);
+        auto stream = co_await res.send_fixed(20);
+        REQUIRE(writer.writes.size() == 1);
+
+        co_await stream.write("0123456789");
+        REQUIRE(writer.writes.size() == 1);
+        co_await stream.write("0123456789");
+        REQUIRE(writer.writes.size() == 2);
+        REQUIRE(writer.writes[1] == "01234567890123456789");
+        REQUIRE(small.pending() == 0);
+    }
+}
@@ -0,0 +1,155 @@
+#include <catch2/catch_test_macros.hpp>
+#include <httc/response_queue.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+#include "async_test.hpp"
+
+namespace {
+
+struct MockWriter {
+    std::vector<std::string> writes;
+
+    asio::awaitable<void> write(httc::WriteBuffers buffers) {
+        std::string current_write;
+        for (const auto& buf : buffers) {
+            current_write.append(static_cast<const char*>(buf.data()), buf.size());
+        }
+        writes.push_back(current_write);
+        co_return;
+    }
+};
+
+// Lets the other coroutines on the executor run
+asio::awaitable<void> yield() {
+    co_await asio::post(co_await asio::this_coro::executor, asio::use_awaitable);
+}
+
+asio::awaitable<void> complete(
+    std::shared_ptr<httc::ResponseQueue> queue, std::shared_ptr<httc::ResponseSlot> slot,
+    std::string output
+) {
+    auto writer = queue->writer(slot);
+    co_await writer.write({ asio::buffer(output) });
+    slot->done = true;
+    queue->notify();
+}
+
+}
+
+ASYNC_TEST_CASE("Response queue") {
+    auto executor = co_await asio::this_coro::executor;
+    auto queue = std::make_shared<httc::ResponseQueue>(executor);
+    MockWriter writer;
+
+    std::optional<bool> result;
+    asio::co_spawn(executor, queue->write_all(writer), [&](std::exception_ptr e, bool r) {
+        if (e)
+            std::rethrow_exception(e);
+        result = r;
+    });
+
+    SECTION("Responses are written in request order") {
+        auto first = queue->push();
+        auto second = queue->push();
+        auto third = queue->push();
+
+        co_await complete(queue, third, "third ");
+        co_await complete(queue, second, "second ");
+        co_await yield();
+        REQUIRE(writer.writes.empty());
+        REQUIRE(queue->size() == 3);
+
+        co_await complete(queue, first, "first ");
+        co_await yield();
+        REQUIRE(writer.writes == std::vector<std::string>{ "first second third " });
+        REQUIRE(queue->size() == 0);
+
+        queue->close();
+        co_await yield();
+        REQUIRE(result == true);
+    }
+
+    SECTION("The oldest response is written as it comes in") {
+        auto first = queue->push();
+        auto second = queue->push();
+        co_await complete(queue, second, "second");
+
+        auto first_writer = queue->writer(first);
+        co_await first_writer.write({ asio::buffer("head ", 5) });
+        co_await yield();
+        REQUIRE(writer.writes == std::vector<std::string>{ "head " });
+
+        co_await first_writer.write({ asio::buffer("body ", 5) });
+        co_await yield();
+        REQUIRE(writer.writes == std::vector<std::string>{ "head ", "body " });
+
+        first->done = true;
+        queue->notify();
+        queue->close();
+        co_await yield();
+        REQUIRE(writer.writes == std::vector<std::string>{ "head ", "body ", "second" });
+        REQUIRE(result == true);
+    }
+
+    SECTION("A closing response stops the writes") {
+        auto first = queue->push();
+        auto second = queue->push();
+        co_await complete(queue, second, "second");
+        first->close = true;
+        co_await complete(queue, first, "error");
+        co_await yield();
+
+        REQUIRE(writer.writes == std::vector<std::string>{ "error" });
+        REQUIRE(result == false);
+    }
+}
+
+ASYNC_TEST_CASE("Response queue output limit") {
+    auto executor = co_await asio::this_coro::executor;
+    auto queue = std::make_shared<httc::ResponseQueue>(executor, 4);
+    MockWriter writer;
+
+    std::optional<bool> result;
+    asio::co_spawn(executor, queue->write_all(writer), [&](std::exception_ptr e, bool r) {
+        if (e)
+            std::rethrow_exception(e);
+        result = r;
+    });
+
+    auto first = queue->push();
+    auto second = queue->push();
+
+    // The second response is held back behind the first one, so its handler waits
+    bool second_written = false;
+    asio::co_spawn(executor, complete(queue, second, "second"), [&](std::exception_ptr e) {
+        if (e)
+            std::rethrow_exception(e);
+        second_written = true;
+    });
+    co_await yield();
+    REQUIRE_FALSE(second_written);
+    REQUIRE(second->output == "second");
+
+    SECTION("The handler continues once its output is taken") {
+        co_await complete(queue, first, "first ");
+        co_await yield();
+        co_await yield();
+        REQUIRE(second_written);
+
+        queue->close();
+        co_await yield();
+        REQUIRE(writer.writes == std::vector<std::string>{ "first ", "second" });
+        REQUIRE(result == true);
+    }
+
+    SECTION("The handler continues once nothing is written anymore") {
+        first->close = true;
+        co_await complete(queue, first, "error");
+        co_await yield();
+        co_await yield();
+        REQUIRE(second_written);
+        REQUIRE(writer.writes == std::vector<std::string>{ "error" });
+        REQUIRE(result == false);
+    }
+}
@@ -10,7 +10,7 @@ namespace methods = httc::methods;
 using asio::awaitable;
 
 struct MockSocket {
-    asio::awaitable<void> write(std::vector<asio::const_buffer> buffers) {
+    asio::awaitable<void> write(httc::WriteBuffers buffers) {
         // Discard all data
         co_return;
     }
@@ -188,6 +188,62 @@ TEST_CASE("Invalid URIs") {
     );
 }
 
+TEST_CASE("Routes that stream their body") {
+    httc::Router router;
+    router.route(
+        "/upload", methods::post([](const httc::Request&, httc::Response&) -> awaitable<void> {
+            co_return;
+        }),
+        { .stream_body = true }
+    );
+    router.route(
+        "/upload", methods::get([](const httc::Request&, httc::Response&) -> awaitable<void> {
+            co_return;
+        })
+    );
+
+    httc::Request req;
+    req.uri = *httc::URI::parse("/upload");
+
+    req.method = "POST";
+    REQUIRE(router.streams_body(req));
+
+    req.method = "GET";
+    REQUIRE(!router.streams_body(req));
+
+    req.method = "OPTIONS";
+    REQUIRE(!router.streams_body(req));
+
+    req.uri = *httc::URI::parse("/other");
+    req.method = "POST";
+    REQUIRE(!router.streams_body(req));
+}
+
+ASYNC_TEST_CASE("Route found beforehand") {
+    httc::Router router;
+    std::string called;
+    router.route(
+        "/users/:id",
+        methods::put([&](const httc::Request& req, httc::Response&) -> awaitable<void> {
+            called = "user " + std::string(req.path_params.at("id"));
+            co_return;
+        }),
+        { .stream_body = true }
+    );
+
+    httc::Request req;
+    req.method = "PUT";
+    req.uri = *httc::URI::parse("/users/7");
+
+    auto route = router.find_route(req);
+    REQUIRE(route.stream_body);
+
+    MockSocket mock_sock;
+    httc::Response res{ mock_sock };
+    co_await router.handle(route, req, res);
+    REQUIRE(called == "user 7");
+}
+
 ASYNC_TEST_CASE("No matching route") {
     httc::Router router;
 
@@ -372,6 +428,185 @@ ASYNC_TEST_CASE("Param and wildcard extraction") {
     REQUIRE(res.status.code == 200);
 }
 
+ASYNC_TEST_CASE("Route tree") {
+    httc::Router router;
+    int called = -1;
+    auto route = [&](std::string_view path, int index) {
+        router.route(path, [&, index](const httc::Request&, httc::Response&) -> awaitable<void> {
+            called = index;
+            co_return;
+        });
+    };
+
+    // Shares and splits the static chains of each other
+    route("/api/v1/users/list", 0);
+    route("/api/v1/users", 1);
+    route("/api/v1/items/list", 2);
+    route("/api/:version/users/:id", 3);
+    route("/api/v1/*", 4);
+
+    auto call = [&](std::string_view path) -> awaitable<int> {
+        called = -1;
+        httc::Request req;
+        req.method = "GET";
+        req.uri = *httc::URI::parse(path);
+        auto res = co_await get_response(router, req);
+        co_return res.status.code == 200 ? called : -1;
+    };
+
+    REQUIRE(co_await call("/api/v1/users/list") == 0);
+    REQUIRE(co_await call("/api/v1/users") == 1);
+    REQUIRE(co_await call("/api/v1/items/list") == 2);
+    REQUIRE(co_await call("/api/v2/users/7") == 3);
+    REQUIRE(co_await call("/api/v1/items") == 4);
+    REQUIRE(co_await call("/api/v1") == 4);
+    REQUIRE(co_await call("/api") == -1);
+    REQUIRE(co_await call("/api/v2/users") == -1);
+
+    // The param match is found after the wildcard in the walk, but still comes first
+    REQUIRE(co_await call("/api/v1/users/7") == 3);
+    REQUIRE(co_await call("/api/v1/users/list/more") == 4);
+
+    // A param does not match an empty segment
+    REQUIRE(co_await call("/api/v2/users/") == -1);
+}
+
+ASYNC_TEST_CASE("Route tree method fallback") {
+    httc::Router router;
+    std::string called;
+
+    router.route(
+        "/users/me", methods::get([&](const httc::Request&, httc::Response&) -> awaitable<void> {
+            called = "me";
+            co_return;
+        })
+    );
+    router.route(
+        "/users/:id", methods::del([&](const httc::Request& req, httc::Response&) -> awaitable<void> {
+            called = "id " + std::string(req.path_params.at("id"));
+            co_return;
+        })
+    );
+
+    httc::Request req;
+    req.uri = *httc::URI::parse("/users/me");
+
+    SECTION("Full match") {
+        req.method = "GET";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == "me");
+    }
+
+    SECTION("Falls back to the param match") {
+        req.method = "DELETE";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == "id me");
+    }
+
+    SECTION("No route for the method") {
+        req.method = "POST";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 405);
+    }
+}
+
+ASYNC_TEST_CASE("Custom method routes") {
+    httc::Router router;
+    std::string called;
+
+    router.route(
+        "/files", httc::MethodWrapper<"PROPFIND", "GET">(
+                      [&](const httc::Request& req, httc::Response&) -> awaitable<void> {
+                          called = req.method.name();
+                          co_return;
+                      }
+                  )
+    );
+    router.route(
+        "/files", httc::MethodWrapper<"MKCOL">(
+                      [&](const httc::Request&, httc::Response&) -> awaitable<void> {
+                          called = "mkcol";
+                          co_return;
+                      }
+                  )
+    );
+
+    httc::Request req;
+    req.uri = *httc::URI::parse("/files");
+
+    SECTION("Custom methods") {
+        req.method = "PROPFIND";
+        {
+            auto res = co_await get_response(router, req);
+            REQUIRE(res.status.code == 200);
+            REQUIRE(called == "PROPFIND");
+        }
+
+        req.method = "MKCOL";
+        {
+            auto res = co_await get_response(router, req);
+            REQUIRE(res.status.code == 200);
+            REQUIRE(called == "mkcol");
+        }
+    }
+
+    SECTION("Standard method of the same route") {
+        req.method = "GET";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == "GET");
+    }
+
+    SECTION("Default OPTIONS handler") {
+        req.method = "OPTIONS";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(res.headers.get_one("Allow") == "GET, OPTIONS, HEAD, PROPFIND, MKCOL");
+    }
+
+    SECTION("No route for the method") {
+        req.method = "COPY";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 405);
+        REQUIRE(called.empty());
+    }
+
+    SECTION("Collision") {
+        auto handler = [](const httc::Request&, httc::Response&) -> awaitable<void> {
+            co_return;
+        };
+        REQUIRE_THROWS_AS(
+            router.route("/files", httc::MethodWrapper<"MKCOL">(handler)), httc::URICollision
+        );
+        REQUIRE_NOTHROW(router.route("/files", httc::MethodWrapper<"COPY">(handler)));
+    }
+}
+
+ASYNC_TEST_CASE("Move-only handlers") {
+    httc::Router router;
+    auto count = std::make_unique<int>(0);
+    int* observed = count.get();
+
+    router.route(
+        "/count", methods::get([count = std::move(count)](
+                                   const httc::Request&, httc::Response&
+                               ) -> awaitable<void> {
+            ++*count;
+            co_return;
+        })
+    );
+
+    httc::Request req;
+    req.method = "GET";
+    req.uri = *httc::URI::parse("/count");
+    co_await get_response(router, req);
+    req.method = "HEAD";
+    co_await get_response(router, req);
+    REQUIRE(*observed == 2);
+}
+
 ASYNC_TEST_CASE("Middleware") {
     httc::Router router;
     std::vector<int> call_order;
@@ -425,3 +660,50 @@ ASYNC_TEST_CASE("Middleware") {
         REQUIRE(call_order[3] == 5);
     }
 }
+
+ASYNC_TEST_CASE("Middleware short circuit") {
+    httc::Router router;
+    int called = 0;
+
+    router
+        .wrap([&](httc::Request& req, httc::Response& res, httc::Next next) -> awaitable<void> {
+            if (req.headers.get_one("Authorization").has_value()) {
+                co_await next(req, res);
+            } else {
+                res.status = httc::StatusCode::UNAUTHORIZED;
+            }
+        })
+        .route("/test", [&](const httc::Request&, httc::Response&) -> awaitable<void> {
+            called++;
+            co_return;
+        });
+
+    httc::Request req;
+    req.method = "GET";
+    req.uri = *httc::URI::parse("/test");
+
+    {
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 401);
+        REQUIRE(called == 0);
+    }
+
+    req.headers.add("Authorization", "token");
+    {
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == 1);
+    }
+
+    // Routes added after the middleware are wrapped too, and the chain can run again
+    router.route("/other", [&](const httc::Request&, httc::Response&) -> awaitable<void> {
+        called++;
+        co_return;
+    });
+    req.uri = *httc::URI::parse("/other");
+    {
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == 2);
+    }
+}
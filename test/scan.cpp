@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+#include <httc/scan.hpp>
+#include <string>
+#include <vector>
+
+TEST_CASE("Find CRLF") {
+    SECTION("Simple line") {
+        REQUIRE(httc::find_crlf("GET / HTTP/1.1\r\n") == 14);
+    }
+
+    SECTION("No CRLF") {
+        REQUIRE(httc::find_crlf("") == std::string_view::npos);
+        REQUIRE(httc::find_crlf("no line end") == std::string_view::npos);
+        REQUIRE(httc::find_crlf("only cr\r") == std::string_view::npos);
+        REQUIRE(httc::find_crlf("lf then cr\n\r") == std::string_view::npos);
+    }
+
+    SECTION("Start offset") {
+        std::string_view data = "a\r\nb\r\nc";
+        REQUIRE(httc::find_crlf(data, 0) == 1);
+        REQUIRE(httc::find_crlf(data, 2) == 4);
+        REQUIRE(httc::find_crlf(data, 5) == std::string_view::npos);
+    }
+
+    SECTION("Every position across block boundaries") {
+        for (std::size_t pos = 0; pos < 100; pos++) {
+            std::string data(pos, 'x');
+            data += "\r\n";
+            data += std::string(40, 'y');
+            REQUIRE(httc::find_crlf(data) == pos);
+
+            // A lone CR or LF before the real CRLF must be skipped
+            std::string noisy(pos, '\r');
+            noisy += "\n";
+            if (pos > 0) {
+                REQUIRE(httc::find_crlf(noisy) == pos - 1);
+            }
+        }
+    }
+}
+
+TEST_CASE("Scan header lines") {
+    std::vector<std::size_t> line_ends;
+
+    SECTION("Complete block") {
+        std::string_view block = "Host: a\r\nAccept: b\r\n\r\nbody";
+        auto end = httc::scan_header_lines(block, 0, line_ends);
+        REQUIRE(end == 22);
+        REQUIRE(line_ends == std::vector<std::size_t>{ 7, 18, 20 });
+    }
+
+    SECTION("Empty block") {
+        auto end = httc::scan_header_lines("\r\nGET", 0, line_ends);
+        REQUIRE(end == 2);
+        REQUIRE(line_ends == std::vector<std::size_t>{ 0 });
+    }
+
+    SECTION("Incomplete block") {
+        auto end = httc::scan_header_lines("Host: a\r\nAccept: b\r\n", 0, line_ends);
+        REQUIRE(end == std::string_view::npos);
+        REQUIRE(line_ends == std::vector<std::size_t>{ 7, 18 });
+    }
+
+    SECTION("Long block") {
+        std::string block;
+        std::vector<std::size_t> expected;
+        for (int i = 0; i < 200; i++) {
+            block += "X-Header-" + std::to_string(i) + ": value";
+            expected.push_back(block.size());
+            block += "\r\n";
+        }
+        expected.push_back(block.size());
+        block += "\r\n";
+
+        auto end = httc::scan_header_lines(block, 0, line_ends);
+        REQUIRE(end == block.size());
+        REQUIRE(line_ends == expected);
+    }
+}
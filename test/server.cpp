@@ -0,0 +1,62 @@
+#include <asio.hpp>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <format>
+#include <future>
+#include <httc/request.hpp>
+#include <httc/response.hpp>
+#include <httc/router.hpp>
+#include <httc/server.hpp>
+#include <memory>
+#include <string>
+
+using asio::awaitable;
+
+namespace {
+
+// Sends a request on a new connection and returns the response, up to the end of `body`
+std::string fetch(unsigned short port, std::string_view path, std::string_view body) {
+    asio::io_context io_ctx;
+    asio::ip::tcp::socket socket(io_ctx);
+    socket.connect({ asio::ip::make_address("127.0.0.1"), port });
+
+    auto request = std::format("GET {} HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    asio::write(socket, asio::buffer(request));
+
+    std::string response;
+    asio::read_until(socket, asio::dynamic_buffer(response), body);
+    return response;
+}
+
+}
+
+TEST_CASE("Server") {
+    std::atomic<int> handled = 0;
+    auto router = std::make_shared<httc::Router>();
+    router->route("/hello", [&](const httc::Request&, httc::Response& res) -> awaitable<void> {
+        handled++;
+        res.set_body("Hello, world");
+        co_return;
+    });
+
+    httc::ServerConfig config;
+    config.threads = 2;
+    config.pin_threads = true;
+    httc::Server server("127.0.0.1", 0, router, config);
+    REQUIRE(server.port() != 0);
+    REQUIRE(server.threads() == 2);
+
+    auto running = std::async(std::launch::async, [&] {
+        server.run();
+    });
+
+    for (int i = 0; i < 8; i++) {
+        auto response = fetch(server.port(), "/hello", "Hello, world");
+        REQUIRE(response.starts_with("HTTP/1.1 200"));
+    }
+    REQUIRE(handled == 8);
+
+    server.stop();
+    REQUIRE(running.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+}
@@ -0,0 +1,72 @@
+#include <catch2/catch_test_macros.hpp>
+#include <httc/small_vector.hpp>
+#include <utility>
+
+TEST_CASE("Small vector inline and heap storage") {
+    httc::SmallVector<int, 4> vec;
+    REQUIRE(vec.empty());
+    REQUIRE(vec.capacity() == 4);
+
+    for (int i = 0; i < 4; i++) {
+        vec.push_back(i);
+    }
+    REQUIRE(vec.size() == 4);
+    REQUIRE(vec.capacity() == 4);
+
+    SECTION("Grows past the inline capacity") {
+        for (int i = 4; i < 10; i++) {
+            vec.push_back(i);
+        }
+        REQUIRE(vec.size() == 10);
+        REQUIRE(vec.capacity() >= 10);
+        for (int i = 0; i < 10; i++) {
+            REQUIRE(vec[i] == i);
+        }
+        REQUIRE(vec.back() == 9);
+    }
+
+    SECTION("Truncate and clear") {
+        vec.truncate(2);
+        REQUIRE(vec.size() == 2);
+        REQUIRE(vec.back() == 1);
+
+        vec.truncate(3);
+        REQUIRE(vec.size() == 2);
+
+        vec.clear();
+        REQUIRE(vec.empty());
+        REQUIRE(vec.begin() == vec.end());
+    }
+}
+
+TEST_CASE("Small vector copy and move") {
+    httc::SmallVector<int, 2> small;
+    small.push_back(1);
+    httc::SmallVector<int, 2> large;
+    for (int i = 0; i < 5; i++) {
+        large.push_back(i);
+    }
+
+    SECTION("Copy") {
+        auto small_copy = small;
+        auto large_copy = large;
+        large_copy[0] = 42;
+        REQUIRE(small_copy.size() == 1);
+        REQUIRE(small_copy[0] == 1);
+        REQUIRE(large_copy.size() == 5);
+        REQUIRE(large[0] == 0);
+    }
+
+    SECTION("Move") {
+        auto heap = large.data();
+        auto moved = std::move(large);
+        REQUIRE(moved.data() == heap);
+        REQUIRE(moved.size() == 5);
+        REQUIRE(large.empty());
+
+        moved = std::move(small);
+        REQUIRE(moved.size() == 1);
+        REQUIRE(moved[0] == 1);
+        REQUIRE(moved.capacity() == 2);
+    }
+}
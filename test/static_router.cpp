@@ -0,0 +1,270 @@
+#include <asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <httc/request.hpp>
+#include <httc/response.hpp>
+#include <httc/static_router.hpp>
+#include <httc/status.hpp>
+#include <string>
+#include "async_test.hpp"
+
+using asio::awaitable;
+
+namespace {
+
+struct MockSocket {
+    asio::awaitable<void> write(httc::WriteBuffers buffers) {
+        // Discard all data
+        co_return;
+    }
+};
+
+template<typename R>
+asio::awaitable<httc::Response> get_response(const R& router, httc::Request& req) {
+    MockSocket mock_sock;
+    httc::Response res{ mock_sock };
+    co_await router.handle(req, res);
+    co_return res;
+}
+
+// Records its name and the params of the request
+struct Record {
+    std::string* called;
+    std::string name;
+
+    awaitable<void> operator()(const httc::Request& req, httc::Response&) const {
+        *called = name;
+        for (const auto& param : { "id", "version" }) {
+            if (req.path_params.contains(param)) {
+                *called += " ";
+                *called += req.path_params.at(param);
+            }
+        }
+        if (!req.wildcard_path.empty()) {
+            *called += " ";
+            *called += req.wildcard_path;
+        }
+        co_return;
+    }
+};
+
+struct Ping {
+    awaitable<void> operator()(const httc::Request&, httc::Response& res) const {
+        res.status = httc::StatusCode::NO_CONTENT;
+        co_return;
+    }
+};
+
+template<std::size_t N>
+constexpr bool collides(const std::array<std::string_view, N>& paths, bool all_methods = true) {
+    httc::StaticRouteTree<32, 0> tree;
+    for (std::size_t i = 0; i < N; i++) {
+        tree.insert(
+            i, httc::RoutePattern<16>(paths[i]).view(), all_methods, { httc::Method::GET }, {}
+        );
+    }
+    return tree.collision;
+}
+
+// Inserts "/files" once for each list of custom methods
+constexpr bool custom_collides(std::string_view first, std::string_view second) {
+    httc::StaticRouteTree<4, 2> tree;
+    std::array<std::string_view, 1> tokens[] = { { first }, { second } };
+    for (std::size_t i = 0; i < 2; i++) {
+        tree.insert(i, httc::RoutePattern<8>("/files").view(), false, {}, tokens[i]);
+    }
+    return tree.collision;
+}
+
+}
+
+TEST_CASE("Static route patterns") {
+    constexpr httc::RoutePattern<16> pattern("/users//:id/*");
+    static_assert(pattern.valid);
+    static_assert(pattern.size == 3);
+    static_assert(pattern.segments[0].kind == httc::RouteSegment::STATIC);
+    static_assert(pattern.segments[0].text == "users");
+    static_assert(pattern.segments[1].kind == httc::RouteSegment::PARAM);
+    static_assert(pattern.segments[2].kind == httc::RouteSegment::WILDCARD);
+
+    // Split like URI::parse, which keeps an empty last segment
+    static_assert(httc::RoutePattern<2>("/").size == 1);
+    static_assert(httc::RoutePattern<2>("/").segments[0].text.empty());
+
+    static_assert(!httc::RoutePattern<8>("users").valid);
+    static_assert(!httc::RoutePattern<8>("/*/users").valid);
+    static_assert(!httc::RoutePattern<8>("/a?b=c").valid);
+    static_assert(!httc::RoutePattern<8>("/a%20b").valid);
+}
+
+TEST_CASE("Static routing collisions") {
+    static_assert(!collides<2>({ "/users", "/items" }));
+    static_assert(collides<2>({ "/users", "/users" }));
+    static_assert(collides<2>({ "/users/:id", "/users/:name" }));
+    static_assert(!collides<2>({ "/users/:id", "/users/*" }));
+    static_assert(collides<2>({ "/users/*", "/users/*" }, false));
+    static_assert(!collides<3>({ "/a/b/c", "/a/b", "/a/c" }));
+    static_assert(custom_collides("PROPFIND", "PROPFIND"));
+    static_assert(!custom_collides("PROPFIND", "MKCOL"));
+}
+
+ASYNC_TEST_CASE("Static routing") {
+    std::string called;
+    httc::StaticRouter<
+        httc::Route<"/api/v1/users/list", Record>, httc::Route<"/api/v1/users", Record>,
+        httc::Route<"/api/:version/users/:id", Record>, httc::Route<"/api/v1/*", Record>,
+        httc::Route<"/ping", Ping>>
+        router(
+            Record{ &called, "list" }, Record{ &called, "users" }, Record{ &called, "user" },
+            Record{ &called, "wild" }, Ping{}
+        );
+
+    auto call = [&](std::string_view path) -> awaitable<std::string> {
+        called = "";
+        httc::Request req;
+        req.method = "GET";
+        req.uri = *httc::URI::parse(path);
+        auto res = co_await get_response(router, req);
+        co_return res.status.code == 200 ? called : std::to_string(res.status.code);
+    };
+
+    REQUIRE(co_await call("/api/v1/users/list") == "list");
+    REQUIRE(co_await call("/api/v1/users") == "users");
+    REQUIRE(co_await call("/api/v2/users/7") == "user 7 v2");
+    REQUIRE(co_await call("/api/v1/items/list") == "wild items/list");
+    REQUIRE(co_await call("/api/v1") == "wild");
+    REQUIRE(co_await call("/api") == "404");
+    REQUIRE(co_await call("/api/v2/users") == "404");
+    REQUIRE(co_await call("/api/v2/users/") == "404");
+
+    // The param match comes before the wildcard match
+    REQUIRE(co_await call("/api/v1/users/7") == "user 7 v1");
+    REQUIRE(co_await call("/api/v1/users/list/more") == "wild users/list/more");
+
+    REQUIRE(co_await call("/ping") == "204");
+}
+
+ASYNC_TEST_CASE("Static routing methods") {
+    std::string called;
+    httc::StaticRouter<
+        httc::Route<"/users/me", Record, "GET">, httc::Route<"/users/:id", Record, "DELETE">>
+        router(Record{ &called, "me" }, Record{ &called, "user" });
+
+    httc::Request req;
+    req.uri = *httc::URI::parse("/users/me");
+
+    SECTION("Full match") {
+        req.method = "GET";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == "me");
+    }
+
+    SECTION("HEAD is handled by GET") {
+        req.method = "HEAD";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == "me");
+        REQUIRE(req.method == httc::Method::GET);
+    }
+
+    SECTION("Falls back to the param match") {
+        req.method = "DELETE";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called == "user me");
+    }
+
+    SECTION("Default OPTIONS handler") {
+        req.method = "OPTIONS";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(called.empty());
+        REQUIRE(res.headers.get_one("Allow") == "GET, OPTIONS, HEAD");
+    }
+
+    SECTION("No route for the method") {
+        req.method = "POST";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 405);
+    }
+}
+
+ASYNC_TEST_CASE("Static routing custom methods") {
+    std::string called;
+    httc::StaticRouter<
+        httc::Route<"/files", Record, "GET", "PROPFIND">, httc::Route<"/files", Record, "MKCOL">>
+        router(Record{ &called, "files" }, Record{ &called, "mkcol" });
+
+    httc::Request req;
+    req.uri = *httc::URI::parse("/files");
+
+    SECTION("Custom method") {
+        req.method = "PROPFIND";
+        {
+            auto res = co_await get_response(router, req);
+            REQUIRE(res.status.code == 200);
+            REQUIRE(called == "files");
+        }
+
+        req.method = "MKCOL";
+        {
+            auto res = co_await get_response(router, req);
+            REQUIRE(res.status.code == 200);
+            REQUIRE(called == "mkcol");
+        }
+    }
+
+    SECTION("Default OPTIONS handler") {
+        req.method = "OPTIONS";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 200);
+        REQUIRE(res.headers.get_one("Allow") == "GET, OPTIONS, HEAD, PROPFIND, MKCOL");
+    }
+
+    SECTION("No route for the method") {
+        req.method = "COPY";
+        auto res = co_await get_response(router, req);
+        REQUIRE(res.status.code == 405);
+    }
+}
+
+ASYNC_TEST_CASE("Static routing with a route found beforehand") {
+    std::string called;
+    httc::StaticRouter<
+        httc::Route<"/users/me", Record, "GET">, httc::StreamingRoute<"/users/:id", Record, "PUT">>
+        router(Record{ &called, "me" }, Record{ &called, "user" });
+
+    httc::Request req;
+    req.method = "PUT";
+    req.uri = *httc::URI::parse("/users/7");
+
+    auto route = router.find_route(req);
+    REQUIRE(route.stream_body);
+
+    MockSocket mock_sock;
+    httc::Response res{ mock_sock };
+    co_await router.handle(route, req, res);
+    REQUIRE(called == "user 7");
+}
+
+TEST_CASE("Static routing streamed bodies") {
+    httc::StaticRouter<
+        httc::StreamingRoute<"/upload", Ping, "POST">, httc::Route<"/upload", Ping, "GET">>
+        router;
+
+    httc::Request req;
+    req.uri = *httc::URI::parse("/upload");
+
+    req.method = "POST";
+    REQUIRE(router.streams_body(req));
+
+    req.method = "GET";
+    REQUIRE(!router.streams_body(req));
+
+    req.method = "OPTIONS";
+    REQUIRE(!router.streams_body(req));
+
+    req.uri = *httc::URI::parse("/other");
+    req.method = "POST";
+    REQUIRE(!router.streams_body(req));
+}
@@ -0,0 +1,95 @@
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <httc/unique_function.hpp>
+#include <memory>
+#include <utility>
+
+namespace {
+
+// Counts the live copies of a callable
+struct Counted {
+    int* live;
+    std::array<char, 16> padding{};
+
+    explicit Counted(int* live) : live(live) {
+        ++*live;
+    }
+    Counted(Counted&& other) noexcept : live(other.live) {
+        ++*live;
+    }
+    ~Counted() {
+        --*live;
+    }
+
+    int operator()(int x) {
+        return x + 1;
+    }
+};
+
+struct Large : Counted {
+    using Counted::Counted;
+    std::array<char, 256> more{};
+};
+
+int twice(int x) {
+    return x * 2;
+}
+
+}
+
+TEST_CASE("Unique function calls") {
+    httc::UniqueFunction<int(int)> empty;
+    REQUIRE(!empty);
+
+    httc::UniqueFunction<int(int)> fn = twice;
+    REQUIRE(fn);
+    REQUIRE(fn(4) == 8);
+
+    int (*null_fn)(int) = nullptr;
+    httc::UniqueFunction<int(int)> from_null = null_fn;
+    REQUIRE(!from_null);
+
+    // Move-only state, and a non-const call through a const reference
+    const httc::UniqueFunction<int(int)> owning = [value = std::make_unique<int>(3)](int x) mutable {
+        return x + (*value)++;
+    };
+    REQUIRE(owning(1) == 4);
+    REQUIRE(owning(1) == 5);
+}
+
+TEST_CASE("Unique function storage") {
+    int live = 0;
+
+    SECTION("Inline") {
+        {
+            httc::UniqueFunction<int(int)> fn = Counted(&live);
+            REQUIRE(live == 1);
+
+            auto moved = std::move(fn);
+            REQUIRE(!fn);
+            REQUIRE(live == 1);
+            REQUIRE(moved(1) == 2);
+
+            moved = nullptr;
+            REQUIRE(live == 0);
+            moved = Counted(&live);
+            REQUIRE(live == 1);
+        }
+        REQUIRE(live == 0);
+    }
+
+    SECTION("Heap") {
+        {
+            httc::UniqueFunction<int(int)> fn = Large(&live);
+            REQUIRE(live == 1);
+
+            // Moves the pointer, not the callable
+            httc::UniqueFunction<int(int)> moved;
+            moved = std::move(fn);
+            REQUIRE(!fn);
+            REQUIRE(live == 1);
+            REQUIRE(moved(2) == 3);
+        }
+        REQUIRE(live == 0);
+    }
+}
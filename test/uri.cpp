@@ -118,6 +118,79 @@ TEST_CASE("Parse URIs with query parameters") {
     }
 }
 
+TEST_CASE("Parse percent-encoded URIs") {
+    SECTION("Path segments") {
+        auto uri = httc::URI::parse("/files/my%20file%2Ftxt/b");
+        REQUIRE(uri.has_value());
+        REQUIRE(uri->paths().size() == 3);
+        REQUIRE(uri->paths()[0] == "files");
+        REQUIRE(uri->paths()[1] == "my file/txt");
+        REQUIRE(uri->paths()[2] == "b");
+        REQUIRE(uri->path() == "/files/my file/txt/b");
+    }
+
+    SECTION("Path from a segment") {
+        auto uri = httc::URI::parse("/files/a%20b//c%2Fd/e?x=1");
+        REQUIRE(uri.has_value());
+        REQUIRE(uri->paths().size() == 4);
+        REQUIRE(uri->path_from(0) == "files/a b/c/d/e");
+        REQUIRE(uri->path_from(1) == "a b/c/d/e");
+        REQUIRE(uri->path_from(3) == "e");
+        REQUIRE(uri->path_from(4).empty());
+        REQUIRE(uri->query_param("x") == "1");
+    }
+
+    SECTION("Path views taken before the query is decoded") {
+        auto uri = httc::URI::parse("/files/a%20b/c?name=x%20y&page=%32");
+        REQUIRE(uri.has_value());
+        auto paths = uri->paths();
+        auto segment = paths[1];
+        auto rest = uri->path_from(1);
+
+        // Decoding the query rewrites it in place, after the path
+        REQUIRE(uri->query_param("name") == "x y");
+        REQUIRE(uri->query_param("page") == "2");
+
+        REQUIRE(paths.size() == 3);
+        REQUIRE(paths[0] == "files");
+        REQUIRE(segment == "a b");
+        REQUIRE(rest == "a b/c");
+        REQUIRE(uri->path_from(1) == rest);
+    }
+
+    SECTION("Query parameters") {
+        auto uri = httc::URI::parse("/search?q=a%26b&k%3D=%20");
+        REQUIRE(uri.has_value());
+        REQUIRE(uri->query_param("q") == "a&b");
+        REQUIRE(uri->query_param("k=") == " ");
+        REQUIRE(uri->query().size() == 2);
+    }
+
+    SECTION("Invalid encoding in the query") {
+        REQUIRE(!httc::URI::parse("/search?q=%2").has_value());
+        REQUIRE(!httc::URI::parse("/search?q=%zz").has_value());
+    }
+}
+
+TEST_CASE("URI copies") {
+    // Short enough to be stored inline by std::string, so the copy has its own buffer
+    auto uri = httc::URI::parse("/a/b?x=%31");
+    REQUIRE(uri.has_value());
+
+    auto copy = *uri;
+    auto moved = std::move(*uri);
+    for (const auto& u : { copy, moved }) {
+        REQUIRE(u.paths().size() == 2);
+        REQUIRE(u.paths()[1] == "b");
+        REQUIRE(u.query_param("x") == "1");
+    }
+
+    // The query was decoded before copying
+    auto copy2 = copy;
+    REQUIRE(copy2.query_param("x") == "1");
+    REQUIRE(copy2.to_string() == "/a/b?x=1");
+}
+
 TEST_CASE("Parse invalid URIs") {
     SECTION("Missing leading slash") {
         auto uri = httc::URI::parse("invalid/path");
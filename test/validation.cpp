@@ -0,0 +1,71 @@
+#include <catch2/catch_test_macros.hpp>
+#include <httc/validation.hpp>
+#include <string>
+
+namespace {
+
+bool token_char(unsigned char c) {
+    return std::string_view("!#$%&'*+-.^_`|~").find(c) != std::string_view::npos
+           || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+bool cookie_value_char(unsigned char c) {
+    return c >= 0x21 && c <= 0x7E && c != '"' && c != ',' && c != ';' && c != '\\';
+}
+
+bool header_value_char(unsigned char c) {
+    return c == '\t' || (c >= 0x20 && c != 0x7F);
+}
+
+}
+
+TEST_CASE("Validation of single bytes") {
+    for (int i = 0; i < 256; i++) {
+        auto c = static_cast<unsigned char>(i);
+        std::string str(1, static_cast<char>(c));
+        INFO("byte " << i);
+        REQUIRE(httc::valid_token(str) == token_char(c));
+        REQUIRE(httc::valid_cookie_value(str) == cookie_value_char(c));
+        REQUIRE(httc::valid_header_value(str) == header_value_char(c));
+    }
+}
+
+TEST_CASE("Validation of long values") {
+    SECTION("Empty values") {
+        REQUIRE(!httc::valid_token(""));
+        REQUIRE(httc::valid_cookie_value(""));
+        REQUIRE(httc::valid_header_value(""));
+    }
+
+    SECTION("Valid values") {
+        std::string jwt = "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJzdWIiOiIxMjM0NTY3ODkwIn0."
+                          "SflKxwRJSMeKKF2QT4fwpMeJf36POk6yJV_adQssw5c";
+        REQUIRE(httc::valid_token(jwt));
+        REQUIRE(httc::valid_cookie_value(jwt));
+        REQUIRE(httc::valid_header_value("Bearer " + jwt + "\t\x80\xff"));
+    }
+
+    // Every invalid byte must be found, whether it lands in a vectorized block or in the tail
+    SECTION("Invalid byte at every position") {
+        for (std::size_t pos = 0; pos < 100; pos++) {
+            std::string value(100, 'a');
+            INFO("position " << pos);
+
+            value[pos] = ';';
+            REQUIRE(httc::valid_header_value(value));
+            REQUIRE(!httc::valid_cookie_value(value));
+            REQUIRE(!httc::valid_token(value));
+
+            value[pos] = '\x7f';
+            REQUIRE(!httc::valid_header_value(value));
+            REQUIRE(!httc::valid_cookie_value(value));
+
+            value[pos] = '\x01';
+            REQUIRE(!httc::valid_header_value(value));
+
+            value[pos] = '\xff';
+            REQUIRE(httc::valid_header_value(value));
+            REQUIRE(!httc::valid_cookie_value(value));
+        }
+    }
+}